@@ -0,0 +1,507 @@
+#include "audit_log.h"
+#include "database_manager.h"
+#include "trace.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QSqlField>
+#include <QSqlRecord>
+#include <QTextStream>
+#include <QtEndian>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <zlib.h>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char* const SEGMENT_SUFFIX = ".alog";
+const char* const SEGMENT_TIME_FORMAT = "yyyyMMddHHmmsszzz"; // 段文件名前缀：首条事件时间（UTC）
+
+// 把已写入的数据刷到磁盘（每批一次）
+bool syncFile(QFile& file) {
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+quint32 checksum(const char* data, int size) {
+    return quint32(crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(data), uInt(size)));
+}
+
+template <typename T>
+void appendLittleEndian(QByteArray& out, T value) {
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&value), int(sizeof(value)));
+}
+
+void appendString(QByteArray& out, const QString& text) {
+    const QByteArray utf8 = text.toUtf8();
+    appendLittleEndian<quint32>(out, quint32(utf8.size()));
+    out += utf8;
+}
+
+// 负载读取游标：越界即失败，不读出缓冲之外
+class PayloadReader {
+public:
+    PayloadReader(const char* data, int size) : m_data(data), m_size(size) {}
+
+    template <typename T>
+    bool read(T* value) {
+        if (m_size - m_pos < int(sizeof(T))) {
+            return false;
+        }
+        *value = qFromLittleEndian<T>(m_data + m_pos);
+        m_pos += int(sizeof(T));
+        return true;
+    }
+
+    bool readString(QString* text) {
+        quint32 length = 0;
+        if (!read(&length) || length > quint32(m_size - m_pos)) {
+            return false;
+        }
+        *text = QString::fromUtf8(m_data + m_pos, int(length));
+        m_pos += int(length);
+        return true;
+    }
+
+    bool atEnd() const { return m_pos == m_size; }
+
+private:
+    const char* m_data;
+    int m_size;
+    int m_pos = 0;
+};
+
+// 命令行时间参数：接受"yyyy-MM-dd"或"yyyy-MM-dd HH:mm:ss"（本地时间）；仅日期的截止时间取当天结束
+bool parseTime(const QString& text, bool endOfDay, qint64* ms) {
+    QString value = text.trimmed();
+    value.replace(' ', 'T');
+    QDateTime time = QDateTime::fromString(value, Qt::ISODate);
+    if (!time.isValid()) {
+        return false;
+    }
+    if (endOfDay && !value.contains('T')) {
+        time = time.addDays(1).addMSecs(-1);
+    }
+    *ms = time.toMSecsSinceEpoch();
+    return true;
+}
+
+} // namespace
+
+QString AuditEvent::actionName(Action action) {
+    switch (action) {
+    case Borrow: return "借书";
+    case Return: return "还书";
+    case Insert: return "新增";
+    case Update: return "修改";
+    case Delete: return "删除";
+    }
+    return "未知";
+}
+
+bool AuditFilter::matches(const AuditEvent& event) const {
+    return event.timeMs >= fromMs && event.timeMs <= toMs
+           && (readerId.isEmpty() || event.readerId == readerId)
+           && (bookId.isEmpty() || event.bookId == bookId)
+           && (table.isEmpty() || event.table == table);
+}
+
+AuditLog::~AuditLog() {
+    stop();
+}
+
+bool AuditLog::start(const QString& directory) {
+    if (isRunning()) {
+        return true;
+    }
+    if (!QDir().mkpath(directory)) {
+        qCritical() << "创建审计日志目录失败：" << directory;
+        return false;
+    }
+    m_directory = directory;
+    m_actor = qEnvironmentVariable("USERNAME", qEnvironmentVariable("USER"));
+    m_stopping = false;
+    m_flusher = std::thread([this]() { flushLoop(); });
+    m_running.store(true, std::memory_order_release);
+    return true;
+}
+
+void AuditLog::stop() {
+    if (!m_running.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_one();
+    m_flusher.join();
+    m_segment.close();
+}
+
+void AuditLog::record(AuditEvent event) {
+    // 停止后（或停止过程中）到达的事件不再保证写出
+    if (!isRunning()) {
+        return;
+    }
+    if (event.timeMs == 0) {
+        event.timeMs = QDateTime::currentMSecsSinceEpoch();
+    }
+    m_queue.push(std::move(event));
+    // 积压满一批时提前唤醒写线程（不持锁通知，错过时由定时唤醒兜底）
+    if (m_pending.fetch_add(1, std::memory_order_relaxed) + 1 == BATCH_SIZE) {
+        m_wakeup.notify_one();
+    }
+}
+
+void AuditLog::flushLoop() {
+    QVector<AuditEvent> batch;
+    for (;;) {
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wakeup.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this]() {
+                return m_stopping || m_pending.load(std::memory_order_relaxed) >= BATCH_SIZE;
+            });
+            stopping = m_stopping;
+        }
+
+        AuditEvent event;
+        while (m_queue.pop(&event)) {
+            if (event.actor.isEmpty()) {
+                event.actor = m_actor;
+            }
+            batch.append(std::move(event));
+        }
+        if (!batch.isEmpty()) {
+            m_pending.fetch_sub(batch.size(), std::memory_order_relaxed);
+            if (!writeBatch(batch)) {
+                qCritical() << "写入审计日志失败，丢弃" << batch.size() << "条事件";
+            }
+            batch.clear();
+        }
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+bool AuditLog::writeBatch(const QVector<AuditEvent>& batch) {
+    TRACE_SCOPE("audit", "AuditLog::writeBatch");
+    QByteArray data;
+    for (const AuditEvent& event : batch) {
+        const QByteArray payload = encode(event);
+        appendLittleEndian<quint32>(data, quint32(payload.size()));
+        appendLittleEndian<quint32>(data, checksum(payload.constData(), payload.size()));
+        data += payload;
+    }
+
+    // 当前段写满（或尚未打开）时换新段；单批超过段上限也整批写入同一段，不拆分
+    const bool full = m_segment.isOpen() && m_segment.size() > SEGMENT_HEADER_SIZE
+                      && m_segment.size() + data.size() > SEGMENT_SIZE;
+    if ((!m_segment.isOpen() || full) && !openSegment(batch.first().timeMs)) {
+        return false;
+    }
+
+    // 整批一次写入、一次同步
+    if (m_segment.write(data) != data.size() || !m_segment.flush() || !syncFile(m_segment)) {
+        qCritical() << "写入审计日志段失败：" << m_segment.fileName() << m_segment.errorString();
+        m_segment.close(); // 下一批换新段，不在可能已损坏的段尾继续追加
+        return false;
+    }
+    return true;
+}
+
+bool AuditLog::openSegment(qint64 firstEventMs) {
+    m_segment.close();
+    const QString name = QString("%1-%2-%3%4")
+                             .arg(QDateTime::fromMSecsSinceEpoch(firstEventMs, Qt::UTC).toString(SEGMENT_TIME_FORMAT))
+                             .arg(QCoreApplication::applicationPid())
+                             .arg(++m_segmentIndex)
+                             .arg(SEGMENT_SUFFIX);
+    m_segment.setFileName(QDir(m_directory).filePath(name));
+    // NewOnly：只创建新文件，绝不覆盖已有段
+    if (!m_segment.open(QIODevice::WriteOnly | QIODevice::NewOnly)) {
+        qCritical() << "创建审计日志段失败：" << m_segment.fileName() << m_segment.errorString();
+        return false;
+    }
+
+    QByteArray header(SEGMENT_MAGIC, int(sizeof(SEGMENT_MAGIC)));
+    appendLittleEndian<quint32>(header, FORMAT_VERSION);
+    if (m_segment.write(header) != header.size()) {
+        qCritical() << "写入审计日志段头失败：" << m_segment.errorString();
+        m_segment.close();
+        return false;
+    }
+    return true;
+}
+
+QByteArray AuditLog::encode(const AuditEvent& event) {
+    QByteArray payload;
+    appendLittleEndian<qint64>(payload, event.timeMs);
+    payload += char(event.action);
+    appendString(payload, event.table);
+    appendString(payload, event.branch);
+    appendString(payload, event.rowKey);
+    appendString(payload, event.bookId);
+    appendString(payload, event.readerId);
+    appendString(payload, event.actor);
+    appendString(payload, event.detail);
+    return payload;
+}
+
+bool AuditLog::decode(const char* data, int size, AuditEvent* event) {
+    PayloadReader reader(data, size);
+    quint8 action = 0;
+    if (!reader.read(&event->timeMs) || !reader.read(&action) || action < AuditEvent::Borrow
+        || action > AuditEvent::Delete) {
+        return false;
+    }
+    event->action = AuditEvent::Action(action);
+    return reader.readString(&event->table) && reader.readString(&event->branch)
+           && reader.readString(&event->rowKey) && reader.readString(&event->bookId)
+           && reader.readString(&event->readerId) && reader.readString(&event->actor)
+           && reader.readString(&event->detail) && reader.atEnd();
+}
+
+bool AuditLog::readSegment(const QString& filePath, const AuditFilter& filter, QVector<AuditEvent>* events,
+                           ScanStats* stats) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "打开审计日志段失败：" << filePath << file.errorString();
+        return false;
+    }
+    const qint64 size = file.size();
+    if (size < SEGMENT_HEADER_SIZE) {
+        ++stats->damagedSegments;
+        return true;
+    }
+    const uchar* mapped = file.map(0, size);
+    if (!mapped) {
+        qCritical() << "映射审计日志段失败：" << filePath << file.errorString();
+        return false;
+    }
+    const char* data = reinterpret_cast<const char*>(mapped);
+    if (std::memcmp(data, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0
+        || qFromLittleEndian<quint32>(data + sizeof(SEGMENT_MAGIC)) != FORMAT_VERSION) {
+        qWarning() << "审计日志段格式不符，已跳过：" << filePath;
+        ++stats->damagedSegments;
+        return true;
+    }
+
+    // 逐条校验长度与CRC：遇到损坏（通常是进程崩溃时未写完的末批）即停止读取本段
+    qint64 pos = SEGMENT_HEADER_SIZE;
+    AuditEvent event;
+    while (pos < size) {
+        if (size - pos < 8) {
+            ++stats->damagedSegments;
+            break;
+        }
+        const quint32 length = qFromLittleEndian<quint32>(data + pos);
+        const quint32 crc = qFromLittleEndian<quint32>(data + pos + 4);
+        const char* payload = data + pos + 8;
+        if (length > quint32(MAX_RECORD_SIZE) || qint64(length) > size - pos - 8
+            || checksum(payload, int(length)) != crc || !decode(payload, int(length), &event)) {
+            qWarning() << "审计日志段在偏移" << pos << "处损坏，其后内容已跳过：" << filePath;
+            ++stats->damagedSegments;
+            break;
+        }
+        ++stats->events;
+        if (filter.matches(event)) {
+            events->append(event);
+        }
+        pos += 8 + qint64(length);
+    }
+    return true;
+}
+
+bool AuditLog::query(const QString& directory, const AuditFilter& filter, QVector<AuditEvent>* events,
+                     ScanStats* stats) {
+    TRACE_SCOPE("audit", "AuditLog::query");
+    ScanStats localStats;
+    if (!stats) {
+        stats = &localStats;
+    }
+    *stats = ScanStats();
+    events->clear();
+
+    const QDir dir(directory);
+    const QStringList names = dir.entryList({QString("*") + SEGMENT_SUFFIX}, QDir::Files, QDir::Name);
+    for (const QString& name : names) {
+        // 段内事件不早于文件名中的首条事件时间：起点晚于查询截止时间的段无需打开
+        const QDateTime first = QDateTime::fromString(name.left(int(qstrlen(SEGMENT_TIME_FORMAT))), SEGMENT_TIME_FORMAT);
+        if (first.isValid()) {
+            QDateTime firstUtc = first;
+            firstUtc.setTimeSpec(Qt::UTC);
+            if (firstUtc.toMSecsSinceEpoch() > filter.toMs) {
+                continue;
+            }
+        }
+        ++stats->segments;
+        if (!readSegment(dir.filePath(name), filter, events, stats)) {
+            return false;
+        }
+    }
+
+    // 各进程的段各自有序，合并后按时间排序（同一时刻保持写入顺序）
+    std::stable_sort(events->begin(), events->end(), [](const AuditEvent& a, const AuditEvent& b) {
+        return a.timeMs < b.timeMs;
+    });
+    return true;
+}
+
+bool AuditLog::isQueryCommand(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--audit-query") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int AuditLog::runQuery(const QStringList& arguments) {
+    QTextStream out(stdout);
+    QCommandLineParser parser;
+    parser.addOption({"audit-query", "按时间顺序回放审计事件（可组合下列条件筛选）"});
+    parser.addOption({"db", "总馆数据库文件（审计目录为<文件>.audit）", "path"});
+    parser.addOption({"dir", "审计日志目录（指定时忽略--db）", "path"});
+    parser.addOption({"from", "起始时间（yyyy-MM-dd[ HH:mm:ss]）", "time"});
+    parser.addOption({"to", "截止时间（yyyy-MM-dd[ HH:mm:ss]，仅日期时含当天）", "time"});
+    parser.addOption({"reader", "读者编号", "id"});
+    parser.addOption({"book", "图书编号", "id"});
+    parser.addOption({"table", "表名（book/reader/borrow）", "name"});
+    if (!parser.parse(arguments)) {
+        out << parser.errorText() << "\n" << parser.helpText();
+        return 1;
+    }
+
+    AuditFilter filter;
+    if ((parser.isSet("from") && !parseTime(parser.value("from"), false, &filter.fromMs))
+        || (parser.isSet("to") && !parseTime(parser.value("to"), true, &filter.toMs))) {
+        out << "时间格式错误\n" << parser.helpText();
+        return 1;
+    }
+    filter.readerId = parser.value("reader");
+    filter.bookId = parser.value("book");
+    filter.table = parser.value("table");
+
+    QString directory = parser.value("dir");
+    if (directory.isEmpty()) {
+        DatabaseManager& dbManager = DatabaseManager::getInstance();
+        if (parser.isSet("db")) {
+            dbManager.setDatabasePath(parser.value("db"));
+        }
+        directory = dbManager.auditLogDirectory();
+    }
+
+    QVector<AuditEvent> events;
+    ScanStats stats;
+    if (!query(directory, filter, &events, &stats)) {
+        return 1;
+    }
+
+    out << "时间\t操作\t表\t分馆\t主键\t图书\t读者\t操作者\t说明\n";
+    for (const AuditEvent& event : events) {
+        out << QDateTime::fromMSecsSinceEpoch(event.timeMs).toString("yyyy-MM-dd HH:mm:ss.zzz") << "\t"
+            << AuditEvent::actionName(event.action) << "\t" << event.table << "\t" << event.branch << "\t"
+            << event.rowKey << "\t" << event.bookId << "\t" << event.readerId << "\t" << event.actor << "\t"
+            << event.detail << "\n";
+    }
+    out << QString("共%1条（扫描%2个段、%3条事件，损坏%4个段）\n")
+               .arg(events.size()).arg(stats.segments).arg(stats.events).arg(stats.damagedSegments);
+    return 0;
+}
+
+AuditModelWatcher::AuditModelWatcher(QSqlTableModel* model, int keyColumn, int bookColumn, int readerColumn)
+    : QObject(model), m_model(model), m_keyColumn(keyColumn), m_bookColumn(bookColumn), m_readerColumn(readerColumn) {
+    // 以下信号在submitAll逐行写库之前发出
+    connect(model, &QSqlTableModel::beforeInsert, this, [this](QSqlRecord& record) {
+        stage(AuditEvent::Insert, -1, record);
+    });
+    connect(model, &QSqlTableModel::beforeUpdate, this, [this](int row, QSqlRecord& record) {
+        stage(AuditEvent::Update, row, record);
+    });
+    connect(model, &QSqlTableModel::beforeDelete, this, [this](int row) {
+        stage(AuditEvent::Delete, row, QSqlRecord());
+    });
+}
+
+bool AuditModelWatcher::submitAll() {
+    m_staged.clear();
+    const bool success = m_model->submitAll();
+    if (!success && !m_staged.isEmpty()) {
+        m_staged.removeLast(); // 失败的那一行
+    }
+    AuditLog& auditLog = AuditLog::getInstance();
+    for (AuditEvent& event : m_staged) {
+        auditLog.record(std::move(event));
+    }
+    m_staged.clear();
+    return success;
+}
+
+QSqlRecord AuditModelWatcher::selectStored(const QVariant& key) const {
+    // 模型缓存里只有改后的值：修改/删除前从库中读出原值（与随后的写入在同一连接上）
+    QSqlQuery query(m_model->database());
+    query.prepare(QString("SELECT * FROM %1 WHERE %2 = ?")
+                      .arg(m_model->tableName(), m_model->record().fieldName(m_keyColumn)));
+    query.addBindValue(key);
+    if (!query.exec() || !query.next()) {
+        return QSqlRecord();
+    }
+    return query.record();
+}
+
+void AuditModelWatcher::stage(AuditEvent::Action action, int row, const QSqlRecord& values) {
+    const QVariant key = row >= 0 ? m_model->record(row).value(m_keyColumn) : values.value(m_keyColumn);
+    const QSqlRecord stored = action == AuditEvent::Insert ? QSqlRecord() : selectStored(key);
+    const QSqlRecord& current = action == AuditEvent::Delete ? stored : values;
+
+    AuditEvent event;
+    event.timeMs = QDateTime::currentMSecsSinceEpoch();
+    event.action = action;
+    event.table = m_model->tableName();
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    event.branch = dbManager.branchName(dbManager.currentShard());
+    event.rowKey = key.toString();
+    if (m_bookColumn >= 0) {
+        event.bookId = m_bookColumn == m_keyColumn ? event.rowKey : current.value(m_bookColumn).toString();
+    }
+    if (m_readerColumn >= 0) {
+        event.readerId = m_readerColumn == m_keyColumn ? event.rowKey : current.value(m_readerColumn).toString();
+    }
+
+    // 说明：新增/删除记录整行取值，修改只记录变化的字段（原值 -> 新值）
+    QStringList parts;
+    for (int i = 0; i < current.count(); ++i) {
+        if (action == AuditEvent::Update) {
+            if (!values.isGenerated(i) || stored.isEmpty()) {
+                continue;
+            }
+            const QVariant before = stored.value(i);
+            const QVariant after = values.value(i);
+            if (before == after) {
+                continue;
+            }
+            parts << QString("%1: %2 -> %3").arg(current.fieldName(i), before.toString(), after.toString());
+        } else {
+            parts << QString("%1=%2").arg(current.fieldName(i), current.value(i).toString());
+        }
+    }
+    if (action == AuditEvent::Delete && !m_deleteNote.isEmpty()) {
+        parts << m_deleteNote;
+    }
+    event.detail = parts.join("; ");
+    m_staged.append(event);
+}
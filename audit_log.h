@@ -0,0 +1,152 @@
+#ifndef AUDIT_LOG_H
+#define AUDIT_LOG_H
+
+#include <QFile>
+#include <QObject>
+#include <QSqlRecord>
+#include <QSqlTableModel>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include "mpsc_queue.h"
+
+// 审计事件：一次已提交的数据修改
+struct AuditEvent {
+    enum Action : quint8 {
+        Borrow = 1,  // 借书
+        Return = 2,  // 还书
+        Insert = 3,  // 新增行
+        Update = 4,  // 修改行
+        Delete = 5,  // 删除行
+    };
+
+    qint64 timeMs = 0;  // 提交时间（Unix毫秒）
+    Action action = Update;
+    QString table;      // 表名
+    QString branch;     // 所属分馆
+    QString rowKey;     // 主键（借阅ID/图书编号/读者编号）
+    QString bookId;     // 涉及的图书（无则为空）
+    QString readerId;   // 涉及的读者（无则为空）
+    QString actor;      // 操作者（系统登录用户）
+    QString detail;     // 字段变化等说明
+
+    static QString actionName(Action action);
+};
+
+// 审计查询条件（空字符串表示不限）
+struct AuditFilter {
+    qint64 fromMs = std::numeric_limits<qint64>::min();
+    qint64 toMs = std::numeric_limits<qint64>::max();
+    QString readerId;
+    QString bookId;
+    QString table;
+
+    bool matches(const AuditEvent& event) const;
+};
+
+// 审计日志单例：修改路径只把事件放入无锁队列，由后台线程攒批写入分段追加日志（每批一次fsync）
+// 段文件：文件头(魔数+版本)后逐条记录 [u32长度][u32 CRC32][负载]，写满后换新段，已写内容永不改写
+// 每个进程写自己的段（文件名含首条事件时间与进程号），多进程同时运行不会交错写同一文件
+class AuditLog {
+public:
+    static AuditLog& getInstance() {
+        static AuditLog instance;
+        return instance;
+    }
+
+    AuditLog(const AuditLog&) = delete;
+    AuditLog& operator=(const AuditLog&) = delete;
+
+    // 启动后台写线程（目录不存在时创建）；未启动时record为空操作
+    bool start(const QString& directory);
+
+    // 写出队列中剩余事件并停止写线程（程序退出前调用）
+    void stop();
+
+    bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+
+    // 记录事件（任意线程，不阻塞、不做I/O；未填时间与操作者时自动补全）
+    void record(AuditEvent event);
+
+    // 扫描目录下所有段，按时间顺序返回符合条件的事件（校验失败的记录及其后内容跳过并计入damaged）
+    struct ScanStats {
+        int segments = 0;
+        int damagedSegments = 0;
+        qint64 events = 0;
+    };
+    static bool query(const QString& directory, const AuditFilter& filter, QVector<AuditEvent>* events,
+                      ScanStats* stats = nullptr);
+
+    // 判断命令行是否为审计查询命令（需在创建QApplication前判断）
+    static bool isQueryCommand(int argc, char* argv[]);
+
+    // 命令行查询/回放：按时间顺序输出事件，返回进程退出码
+    static int runQuery(const QStringList& arguments);
+
+private:
+    AuditLog() = default;
+    ~AuditLog();
+
+    void flushLoop();
+    bool writeBatch(const QVector<AuditEvent>& batch);
+    bool openSegment(qint64 firstEventMs);
+
+    static QByteArray encode(const AuditEvent& event);
+    static bool decode(const char* data, int size, AuditEvent* event);
+    static bool readSegment(const QString& filePath, const AuditFilter& filter, QVector<AuditEvent>* events,
+                            ScanStats* stats);
+
+    static constexpr char SEGMENT_MAGIC[8] = {'Z', 'H', 'X', 'M', 'A', 'U', 'D', '1'};
+    static constexpr quint32 FORMAT_VERSION = 1;
+    static constexpr int SEGMENT_HEADER_SIZE = 12;
+    static constexpr qint64 SEGMENT_SIZE = 16 * 1024 * 1024; // 单段上限，超过即换新段
+    static constexpr int MAX_RECORD_SIZE = 1 << 20;          // 读取时长度超过此值视为损坏
+    static constexpr int BATCH_SIZE = 256;                   // 积压达到该数量时立即唤醒写线程
+    static constexpr int FLUSH_INTERVAL_MS = 200;            // 否则按此间隔攒批写出
+
+    MpscQueue<AuditEvent> m_queue;
+    std::atomic<bool> m_running{false};
+    std::atomic<int> m_pending{0};
+    bool m_stopping = false;          // 受m_wakeMutex保护
+    std::mutex m_wakeMutex;           // 仅用于唤醒写线程，入队不加锁
+    std::condition_variable m_wakeup;
+    std::thread m_flusher;
+
+    // 以下仅由写线程访问
+    QString m_directory;
+    QString m_actor;
+    QFile m_segment;
+    int m_segmentIndex = 0;
+};
+
+// 表模型审计：代理submitAll，把提交成功的新增/修改/删除行记入审计日志
+// （QSqlTableModel逐行提交，失败即停止：失败时最后一次before*信号对应的行未写入，其余已写入）
+class AuditModelWatcher : public QObject {
+public:
+    // keyColumn为主键列；bookColumn/readerColumn为涉及图书/读者编号的列（无则-1）
+    AuditModelWatcher(QSqlTableModel* model, int keyColumn, int bookColumn, int readerColumn);
+
+    // 删除事件附加的说明（如级联删除的关联数据）
+    void setDeleteNote(const QString& note) { m_deleteNote = note; }
+
+    // 提交模型的所有修改并记录审计事件
+    bool submitAll();
+
+private:
+    QSqlRecord selectStored(const QVariant& key) const;
+    void stage(AuditEvent::Action action, int row, const QSqlRecord& values);
+
+    QSqlTableModel* m_model;
+    int m_keyColumn;
+    int m_bookColumn;
+    int m_readerColumn;
+    QString m_deleteNote;
+    QVector<AuditEvent> m_staged;
+};
+
+#endif // AUDIT_LOG_H
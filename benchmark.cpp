@@ -0,0 +1,456 @@
+#include "benchmark.h"
+#include "database_manager.h"
+#include "file_exporter.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+namespace {
+
+const char* const HOT_BOOK_ID = "BENCH-0001";
+const int HOT_BOOK_STOCK = 1000000;
+const int EXPORT_BOOK_COUNT = 2000;
+const int EXPORT_READER_COUNT = 5000;
+const char* const PROFILE_READER_ID = "BENCH-PROFILE-R";
+const int PROFILE_SEARCH_COUNT = 50;
+
+QTextStream& out() {
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+} // namespace
+
+bool Benchmark::isBenchmarkCommand(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (QByteArray(argv[i]).startsWith("--bench-")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int Benchmark::run(const QStringList& arguments) {
+    const QString command = arguments.value(1);
+    if (command == "--bench-contention") {
+        return runContention(arguments.value(2, "8").toInt(), arguments.value(3, "200").toInt());
+    }
+    if (command == "--bench-prepare") {
+        return runPrepare(arguments.value(2), arguments.value(3).toInt());
+    }
+    if (command == "--bench-writer") {
+        return runWriter(arguments.value(2), arguments.value(3), arguments.value(4).toInt());
+    }
+    if (command == "--bench-export") {
+        return runExport(arguments.value(2, "200000").toInt());
+    }
+    if (command == "--bench-profiles") {
+        return runProfiles(arguments.value(2, "library.db"), arguments.value(3, "500").toInt(),
+                           arguments.value(4, "3").toInt());
+    }
+    if (command == "--bench-profile-run") {
+        return runProfileWorkload(arguments.value(2), arguments.value(3), arguments.value(4).toInt());
+    }
+
+    out() << "用法：\n"
+          << "  --bench-contention [最大写进程数=8] [每进程操作数=200]  多进程借还写冲突测试\n"
+          << "  --bench-export [借阅记录数=200000]                   各导出格式大小与吞吐量对比\n"
+          << "  --bench-profiles [数据库=library.db] [借还次数=500] [轮数=3]  各存储配置档在当前库副本上的耗时对比\n";
+    out().flush();
+    return 1;
+}
+
+int Benchmark::runPrepare(const QString& dbPath, int readerCount) {
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    dbManager.setDatabasePath(dbPath);
+    if (!dbManager.initTables()) {
+        return 1;
+    }
+
+    QSqlDatabase db = dbManager.getDatabase();
+    QSqlQuery query(db);
+    db.transaction();
+    query.prepare("INSERT INTO book (book_id, book_name, author, category, stock, total_copies) "
+                  "VALUES (?, '基准测试', '基准', '测试', ?, ?)");
+    query.addBindValue(HOT_BOOK_ID);
+    query.addBindValue(HOT_BOOK_STOCK);
+    query.addBindValue(HOT_BOOK_STOCK);
+    bool success = query.exec();
+    query.prepare("INSERT INTO reader (reader_id, reader_name) VALUES (?, '基准读者')");
+    for (int i = 0; success && i < readerCount; ++i) {
+        query.addBindValue(QString("BENCH-R%1").arg(i));
+        success = query.exec();
+    }
+    if (!success || !db.commit()) {
+        db.rollback();
+        qCritical() << "初始化测试库失败：" << query.lastError().text();
+        return 1;
+    }
+    return 0;
+}
+
+int Benchmark::runWriter(const QString& dbPath, const QString& readerId, int ops) {
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    dbManager.setDatabasePath(dbPath);
+    if (!dbManager.initTables()) {
+        return 1;
+    }
+
+    int succeeded = 0;
+    int failed = 0;
+    int openBorrowId = 0;
+    QSqlQuery query(dbManager.getDatabase());
+    for (int i = 0; i < ops; ++i) {
+        bool ok = false;
+        if (openBorrowId == 0) {
+            ok = dbManager.borrowBook(HOT_BOOK_ID, readerId);
+            if (ok) {
+                query.prepare("SELECT max(id) FROM borrow WHERE reader_id = ? AND return_time IS NULL");
+                query.addBindValue(readerId);
+                if (query.exec() && query.next()) {
+                    openBorrowId = query.value(0).toInt();
+                }
+            }
+        } else {
+            ok = dbManager.returnBook(openBorrowId);
+            if (ok) {
+                openBorrowId = 0;
+            }
+        }
+        ok ? ++succeeded : ++failed;
+    }
+
+    // 统计行：成功数 失败数 重试数 重试耗尽数 冲突耗时(ms)
+    const DatabaseManager::ContentionStats stats = dbManager.contentionStats();
+    out() << succeeded << " " << failed << " " << stats.retries << " "
+          << stats.busyFailures << " " << stats.contentionMs << "\n";
+    out().flush();
+    return 0;
+}
+
+int Benchmark::runContention(int maxWriters, int opsPerWriter) {
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        qCritical() << "创建临时目录失败";
+        return 1;
+    }
+    const QString program = QCoreApplication::applicationFilePath();
+
+    out() << "写进程数\t总操作\t吞吐量(次/秒)\t失败率\t重试次数\t平均冲突耗时(ms)\n";
+    for (int writers = 1; writers <= qMax(1, maxWriters); writers *= 2) {
+        const QString dbPath = tempDir.filePath(QString("contention_%1.db").arg(writers));
+        if (QProcess::execute(program, {"--bench-prepare", dbPath, QString::number(writers)}) != 0) {
+            qCritical() << "初始化测试库失败：" << dbPath;
+            return 1;
+        }
+
+        QVector<QProcess*> processes;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < writers; ++i) {
+            QProcess* process = new QProcess;
+            process->start(program, {"--bench-writer", dbPath, QString("BENCH-R%1").arg(i),
+                                     QString::number(opsPerWriter)});
+            processes.append(process);
+        }
+
+        qint64 succeeded = 0;
+        qint64 failed = 0;
+        qint64 retries = 0;
+        qint64 contentionMs = 0;
+        for (QProcess* process : processes) {
+            process->waitForFinished(-1);
+            const QStringList fields = QString::fromUtf8(process->readAllStandardOutput()).trimmed().split(' ');
+            if (process->exitCode() != 0 || fields.size() < 5) {
+                qCritical() << "写进程异常退出：" << process->readAllStandardError();
+                failed += opsPerWriter;
+            } else {
+                succeeded += fields[0].toLongLong();
+                failed += fields[1].toLongLong();
+                retries += fields[2].toLongLong();
+                contentionMs += fields[4].toLongLong();
+            }
+            delete process;
+        }
+        const qint64 elapsedMs = qMax<qint64>(1, timer.elapsed());
+
+        const qint64 total = succeeded + failed;
+        out() << writers << "\t" << total << "\t"
+              << QString::number(succeeded * 1000.0 / elapsedMs, 'f', 1) << "\t"
+              << QString::number(total > 0 ? failed * 100.0 / total : 0.0, 'f', 2) << "%\t"
+              << retries << "\t"
+              << QString::number(double(contentionMs) / writers, 'f', 1) << "\n";
+        out().flush();
+    }
+    return 0;
+}
+
+int Benchmark::runExport(int rows) {
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        qCritical() << "创建临时目录失败";
+        return 1;
+    }
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    dbManager.setDatabasePath(tempDir.filePath("export.db"));
+    if (!dbManager.initTables()) {
+        return 1;
+    }
+
+    // 生成测试数据：借书时间逐条递增，约三分之二已归还
+    QSqlDatabase db = dbManager.getDatabase();
+    QSqlQuery query(db);
+    db.transaction();
+    query.prepare("INSERT INTO book (book_id, book_name, author, category, stock, total_copies) "
+                  "VALUES (?, ?, '基准', '测试', ?, ?)");
+    bool success = true;
+    for (int i = 0; success && i < EXPORT_BOOK_COUNT; ++i) {
+        query.addBindValue(QString("BENCH-B%1").arg(i, 5, 10, QChar('0')));
+        query.addBindValue(QString("基准测试图书%1").arg(i));
+        query.addBindValue(HOT_BOOK_STOCK);
+        query.addBindValue(HOT_BOOK_STOCK);
+        success = query.exec();
+    }
+    query.prepare("INSERT INTO reader (reader_id, reader_name, phone) VALUES (?, ?, ?)");
+    for (int i = 0; success && i < EXPORT_READER_COUNT; ++i) {
+        query.addBindValue(QString("BENCH-R%1").arg(i, 5, 10, QChar('0')));
+        query.addBindValue(QString("基准读者%1").arg(i));
+        query.addBindValue(QString("138%1").arg(i, 8, 10, QChar('0')));
+        success = query.exec();
+    }
+    query.prepare("INSERT INTO borrow (book_id, reader_id, borrow_time, return_time, due_time) "
+                  "VALUES (?, ?, datetime('2024-01-01', ?), ?, datetime('2024-01-01', ?))");
+    for (int i = 0; success && i < rows; ++i) {
+        const QString offset = QString("+%1 minutes").arg(i);
+        query.addBindValue(QString("BENCH-B%1").arg(i % EXPORT_BOOK_COUNT, 5, 10, QChar('0')));
+        query.addBindValue(QString("BENCH-R%1").arg(i % EXPORT_READER_COUNT, 5, 10, QChar('0')));
+        query.addBindValue(offset);
+        query.addBindValue(i % 3 == 0 ? QVariant(QVariant::String) : QVariant("2024-06-01 00:00:00"));
+        query.addBindValue(QString("+%1 minutes").arg(i + 30 * 24 * 60));
+        success = query.exec();
+    }
+    if (!success || !db.commit()) {
+        db.rollback();
+        qCritical() << "初始化测试库失败：" << query.lastError().text();
+        return 1;
+    }
+
+    out() << "格式\t记录数\t文件大小(字节)\t相对CSV\t耗时(ms)\t吞吐量(行/秒)\n";
+    qint64 csvBytes = 0;
+    for (ExportFormat format : ExportSink::availableFormats()) {
+        const QString filePath = tempDir.filePath("export" + ExportSink::fileSuffix(format));
+        QElapsedTimer timer;
+        timer.start();
+        if (!FileExporter::exportBorrowRecords(dbManager.shards(), filePath, format)) {
+            qCritical() << "导出失败：" << ExportSink::displayName(format);
+            return 1;
+        }
+        const qint64 elapsedMs = qMax<qint64>(1, timer.elapsed());
+        const qint64 bytes = QFileInfo(filePath).size();
+        if (format == ExportFormat::Csv) {
+            csvBytes = bytes;
+        }
+
+        out() << ExportSink::displayName(format) << "\t" << rows << "\t" << bytes << "\t"
+              << QString::number(csvBytes > 0 ? bytes * 100.0 / csvBytes : 0.0, 'f', 1) << "%\t"
+              << elapsedMs << "\t"
+              << QString::number(rows * 1000.0 / elapsedMs, 'f', 0) << "\n";
+        out().flush();
+    }
+    return 0;
+}
+
+int Benchmark::runProfiles(const QString& sourcePath, int ops, int rounds) {
+    if (!QFileInfo::exists(sourcePath)) {
+        qCritical() << "数据库不存在：" << sourcePath;
+        return 1;
+    }
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        qCritical() << "创建临时目录失败";
+        return 1;
+    }
+
+    // 当前库（含分馆分片）的一致副本：只读连接上VACUUM INTO，不在原库上建表、升级或回填，不受其他终端写入影响
+    // （建表升级只在负载子进程中对副本执行）
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    dbManager.setDatabasePath(sourcePath);
+    if (!dbManager.loadShards()) {
+        return 1;
+    }
+    const QDir baseDir(tempDir.filePath("base"));
+    QDir().mkpath(baseDir.path());
+    QStringList fileNames;
+    QString mainFileName;
+    for (const ShardInfo& shard : dbManager.shards()) {
+        const QString fileName = QFileInfo(shard.filePath).fileName();
+        ScopedConnection conn(shard.filePath, true);
+        if (!conn.isOpen()) {
+            return 1;
+        }
+        // 文件以只读方式打开，原库不会被写；VACUUM INTO写的是新文件，须解除query_only
+        QSqlQuery query(conn.database());
+        query.exec("PRAGMA query_only = 0");
+        query.prepare("VACUUM INTO ?");
+        query.addBindValue(baseDir.filePath(fileName));
+        if (!query.exec()) {
+            qCritical() << "复制数据库失败：" << shard.filePath << query.lastError().text();
+            return 1;
+        }
+        fileNames << fileName;
+        if (shard.index == 0) {
+            mainFileName = fileName;
+        }
+    }
+
+    struct Timing {
+        qint64 circulationMs = -1;
+        qint64 searchMs = 0;
+        qint64 exportMs = 0;
+
+        qint64 total() const { return circulationMs + searchMs + exportMs; }
+    };
+    QVector<Timing> best(StorageProfile::PROFILE_COUNT);
+
+    // 各轮内轮流运行各配置档，减小系统缓存预热对先后顺序的影响；每次运行都用新的副本，取各档最快的一轮
+    const QString program = QCoreApplication::applicationFilePath();
+    for (int round = 0; round < qMax(1, rounds); ++round) {
+        for (int i = 0; i < StorageProfile::PROFILE_COUNT; ++i) {
+            const StorageProfile& profile = StorageProfile::PROFILES[i];
+            QDir runDir(tempDir.filePath(QString("%1_%2").arg(profile.name).arg(round)));
+            QDir().mkpath(runDir.path());
+            for (const QString& fileName : fileNames) {
+                const QString target = runDir.filePath(fileName);
+                if (!QFile::copy(baseDir.filePath(fileName), target)) {
+                    qCritical() << "复制数据库失败：" << target;
+                    return 1;
+                }
+                // 按本档页大小重写副本（不计入耗时）
+                ScopedConnection conn(target);
+                if (!conn.isOpen() || !profile.rebuild(conn.database())) {
+                    return 1;
+                }
+            }
+
+            QProcess process;
+            process.start(program, {"--bench-profile-run", runDir.filePath(mainFileName), profile.name,
+                                    QString::number(ops)});
+            process.waitForFinished(-1);
+            const QStringList fields = QString::fromUtf8(process.readAllStandardOutput()).trimmed().split(' ');
+            if (process.exitCode() != 0 || fields.size() < 3) {
+                qCritical() << "负载进程异常退出：" << profile.name << process.readAllStandardError();
+                return 1;
+            }
+            Timing timing;
+            timing.circulationMs = fields[0].toLongLong();
+            timing.searchMs = fields[1].toLongLong();
+            timing.exportMs = fields[2].toLongLong();
+            if (best[i].circulationMs < 0 || timing.total() < best[i].total()) {
+                best[i] = timing;
+            }
+            runDir.removeRecursively();
+        }
+    }
+
+    out() << "配置档\t借还" << ops << "次(ms)\t检索" << PROFILE_SEARCH_COUNT << "次(ms)\t导出(ms)\t合计(ms)\t说明\n";
+    int fastest = 0;
+    for (int i = 0; i < StorageProfile::PROFILE_COUNT; ++i) {
+        const StorageProfile& profile = StorageProfile::PROFILES[i];
+        out() << profile.name << "\t" << best[i].circulationMs << "\t" << best[i].searchMs << "\t"
+              << best[i].exportMs << "\t" << best[i].total() << "\t" << profile.description << "\n";
+        if (best[i].total() < best[fastest].total()) {
+            fastest = i;
+        }
+    }
+    out() << QString("本机最快：%1（以 --storage-profile %1 启动即可使用；bulk-load不刷盘，只宜用于可重做的作业）\n")
+                 .arg(StorageProfile::PROFILES[fastest].name);
+    out().flush();
+    return 0;
+}
+
+int Benchmark::runProfileWorkload(const QString& dbPath, const QString& profileName, int ops) {
+    const StorageProfile* profile = StorageProfile::find(profileName);
+    if (!profile) {
+        qCritical() << "未知的存储配置档：" << profileName;
+        return 1;
+    }
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    dbManager.setStorageProfile(*profile);
+    dbManager.setDatabasePath(dbPath);
+    if (!dbManager.initTables()) {
+        return 1;
+    }
+
+    // 借还负载使用专用图书与读者，不受副本中现有库存的影响
+    QSqlDatabase db = dbManager.getDatabase();
+    QSqlQuery query(db);
+    // （OR IGNORE而非OR REPLACE：REPLACE的隐式删除不触发删除触发器，会使变更日志与汇总的负载失真）
+    query.prepare("INSERT OR IGNORE INTO book (book_id, book_name, author, category, stock, total_copies) "
+                  "VALUES (?, '基准测试', '基准', '测试', ?, ?)");
+    query.addBindValue(HOT_BOOK_ID);
+    query.addBindValue(HOT_BOOK_STOCK);
+    query.addBindValue(HOT_BOOK_STOCK);
+    bool success = query.exec();
+    if (success) {
+        // 副本中已有同编号图书时补足库存，保证借还负载不因库存不足中断
+        query.prepare("UPDATE book SET total_copies = total_copies + (? - stock), stock = ? "
+                      "WHERE book_id = ? AND stock < ?");
+        query.addBindValue(HOT_BOOK_STOCK);
+        query.addBindValue(HOT_BOOK_STOCK);
+        query.addBindValue(HOT_BOOK_ID);
+        query.addBindValue(HOT_BOOK_STOCK);
+        success = query.exec();
+    }
+    if (success) {
+        query.prepare("INSERT OR IGNORE INTO reader (reader_id, reader_name) VALUES (?, '基准读者')");
+        query.addBindValue(PROFILE_READER_ID);
+        success = query.exec();
+    }
+    if (!success) {
+        qCritical() << "初始化负载数据失败：" << query.lastError().text();
+        return 1;
+    }
+
+    // 1. 借还：每次借出后立即归还，每次都是一个独立写事务
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < ops; ++i) {
+        if (!dbManager.borrowBook(HOT_BOOK_ID, PROFILE_READER_ID)) {
+            return 1;
+        }
+        query.prepare("SELECT max(id) FROM borrow WHERE reader_id = ? AND return_time IS NULL");
+        query.addBindValue(PROFILE_READER_ID);
+        if (!query.exec() || !query.next() || !dbManager.returnBook(query.value(0).toInt())) {
+            return 1;
+        }
+    }
+    const qint64 circulationMs = timer.restart();
+
+    // 2. 检索：固定关键词轮流跨分片检索
+    const QStringList keywords = {"1", "2", "3", "4", "5", "6", "7", "8", "9", "0", "图", "书", "a", "e"};
+    for (int i = 0; i < PROFILE_SEARCH_COUNT; ++i) {
+        bool ok = false;
+        dbManager.searchBooks(keywords[i % keywords.size()], &ok);
+        if (!ok) {
+            return 1;
+        }
+    }
+    const qint64 searchMs = timer.restart();
+
+    // 3. 导出：全部借阅记录导出为CSV
+    const QString exportPath = QFileInfo(dbPath).absoluteDir().filePath("profile_export.csv");
+    if (!FileExporter::exportBorrowRecords(dbManager.shards(), exportPath, ExportFormat::Csv)) {
+        return 1;
+    }
+    const qint64 exportMs = timer.elapsed();
+    QFile::remove(exportPath);
+
+    out() << circulationMs << " " << searchMs << " " << exportMs << "\n";
+    out().flush();
+    return 0;
+}
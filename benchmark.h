@@ -0,0 +1,38 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QStringList>
+
+// 静态工具类：命令行基准测试（无界面运行，结果输出到标准输出）
+class Benchmark {
+public:
+    // 判断命令行是否为基准测试命令（需在创建QApplication前判断）
+    static bool isBenchmarkCommand(int argc, char* argv[]);
+
+    // 执行基准测试，返回进程退出码
+    static int run(const QStringList& arguments);
+
+private:
+    Benchmark() = default;
+    ~Benchmark() = default;
+
+    // 多进程写冲突测试：写进程数逐级翻倍，统计吞吐量与失败率
+    static int runContention(int maxWriters, int opsPerWriter);
+
+    // 子进程：初始化测试库（图书+读者）
+    static int runPrepare(const QString& dbPath, int readerCount);
+
+    // 子进程：反复借还同一本热门图书，输出统计行
+    static int runWriter(const QString& dbPath, const QString& readerId, int ops);
+
+    // 导出格式对比：同一批借阅记录按各可用格式导出，统计文件大小与吞吐量
+    static int runExport(int rows);
+
+    // 存储配置档对比：在当前库的副本上按各配置档轮流运行同一负载，报告本机最快的配置档
+    static int runProfiles(const QString& sourcePath, int ops, int rounds);
+
+    // 子进程：按指定配置档打开副本，依次运行借还、检索、导出，输出各阶段耗时
+    static int runProfileWorkload(const QString& dbPath, const QString& profileName, int ops);
+};
+
+#endif // BENCHMARK_H
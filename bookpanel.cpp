@@ -1,18 +1,39 @@
 #include "bookpanel.h"
 #include "ui_bookpanel.h"
+#include "trace.h"
+#include "schema.h"
 #include <QMessageBox>
+#include <QProgressDialog>
 
 BookPanel::BookPanel(QWidget *parent) :
     QWidget(parent),
-    ui(new Ui::BookPanel)
+    ui(new Ui::BookPanel),
+    m_changeTracker(BookTable::NAME, DatabaseManager::getInstance().currentShard())
 {
     ui->setupUi(this);
 
-    // 初始化模型并绑定View
-    m_bookModel = DatabaseManager::getInstance().getBookModel(this);
-    ui->bookTableView->setModel(m_bookModel);
+    // 初始化模型并绑定View：目录快照与库中一致时首屏直接读映射文件，实时查询推迟到界面显示之后
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    const CatalogSnapshot* snapshot = dbManager.currentCatalogSnapshot();
+    m_bookModel = dbManager.getBookModel(this, snapshot == nullptr);
+    m_bookAudit = new AuditModelWatcher(m_bookModel, BookTable::BookId, BookTable::BookId, -1);
+    m_bookAudit->setDeleteNote("关联借阅记录已级联删除");
+    m_searchModel = new QStandardItemModel(this);
+    if (snapshot) {
+        m_snapshotModel = new CatalogBookModel(snapshot, this);
+        ui->bookTableView->setModel(m_snapshotModel);
+        QTimer::singleShot(0, this, &BookPanel::onDeferredSelect);
+    } else {
+        ui->bookTableView->setModel(m_bookModel);
+    }
     ui->bookTableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     ui->bookTableView->setSelectionBehavior(QAbstractItemView::SelectRows); // 整行选择
+    ui->bookTableView->setSelectionMode(QAbstractItemView::ExtendedSelection); // 可多选批量删除
+
+    // 定时轮询其他终端的提交，只刷新变动的行
+    m_pollTimer = new QTimer(this);
+    connect(m_pollTimer, &QTimer::timeout, this, &BookPanel::onPollChanges);
+    m_pollTimer->start(CHANGE_POLL_INTERVAL_MS);
 }
 
 BookPanel::~BookPanel()
@@ -23,11 +44,38 @@ BookPanel::~BookPanel()
 
 void BookPanel::refreshBookList()
 {
-    m_bookModel->select(); // 重新查询数据
+    TRACE_SCOPE("ui", "BookPanel::refreshBookList");
+    ui->bookTableView->setModel(m_bookModel);
+    m_changeTracker.sync();
+    DatabaseManager::selectModel(m_bookModel); // 重新查询数据
+}
+
+void BookPanel::onDeferredSelect()
+{
+    TRACE_SCOPE("ui", "BookPanel::onDeferredSelect");
+    // 实时模型只取首批行（其余随视图滚动按需读取），查询完成前视图一直显示快照首屏
+    m_changeTracker.sync();
+    DatabaseManager::selectModel(m_bookModel);
+    // 用户已切到检索结果时不抢占视图
+    if (ui->bookTableView->model() == m_snapshotModel) {
+        ui->bookTableView->setModel(m_bookModel);
+    }
+    m_snapshotModel->deleteLater();
+    m_snapshotModel = nullptr;
+}
+
+void BookPanel::onPollChanges()
+{
+    // 面板不可见时不刷新，切回时一次补齐
+    if (!isVisible()) {
+        return;
+    }
+    m_changeTracker.refreshModel(m_bookModel, BookTable::BookId);
 }
 
 void BookPanel::on_addBookBtn_clicked()
 {
+    TRACE_SCOPE("ui", "BookPanel::on_addBookBtn_clicked");
     // 获取输入值（去空格）
     const QString bookId = ui->bookIdEdit->text().trimmed();
     const QString bookName = ui->bookNameEdit->text().trimmed();
@@ -41,11 +89,8 @@ void BookPanel::on_addBookBtn_clicked()
         return;
     }
 
-    // 检查图书编号是否已存在
-    QSqlQuery query(DatabaseManager::getInstance().getDatabase());
-    query.prepare("SELECT 1 FROM book WHERE book_id = ?");
-    query.addBindValue(bookId);
-    if (query.exec() && query.next()) {
+    // 检查图书编号是否已存在（编号在所有分馆间唯一）
+    if (DatabaseManager::getInstance().findBookShard(bookId) >= 0) {
         QMessageBox::warning(this, "错误", "图书编号已存在！");
         return;
     }
@@ -53,14 +98,15 @@ void BookPanel::on_addBookBtn_clicked()
     // 插入新行
     const int row = m_bookModel->rowCount();
     m_bookModel->insertRow(row);
-    m_bookModel->setData(m_bookModel->index(row, 0), bookId);
-    m_bookModel->setData(m_bookModel->index(row, 1), bookName);
-    m_bookModel->setData(m_bookModel->index(row, 2), author);
-    m_bookModel->setData(m_bookModel->index(row, 3), category);
-    m_bookModel->setData(m_bookModel->index(row, 4), stock);
+    m_bookModel->setData(m_bookModel->index(row, BookTable::BookId), bookId);
+    m_bookModel->setData(m_bookModel->index(row, BookTable::BookName), bookName);
+    m_bookModel->setData(m_bookModel->index(row, BookTable::Author), author);
+    m_bookModel->setData(m_bookModel->index(row, BookTable::Category), category);
+    m_bookModel->setData(m_bookModel->index(row, BookTable::Stock), stock);
+    m_bookModel->setData(m_bookModel->index(row, BookTable::TotalCopies), stock); // 新书尚无借出
 
     // 提交修改
-    if (m_bookModel->submitAll()) {
+    if (m_bookAudit->submitAll()) {
         QMessageBox::information(this, "成功", "新增图书成功！");
         refreshBookList();
         // 清空输入框
@@ -77,54 +123,112 @@ void BookPanel::on_addBookBtn_clicked()
 
 void BookPanel::on_delBookBtn_clicked()
 {
-    // 获取选中行
-    const QModelIndex currentIndex = ui->bookTableView->currentIndex();
-    if (!currentIndex.isValid()) {
+    TRACE_SCOPE("ui", "BookPanel::on_delBookBtn_clicked");
+    // 跨分馆检索结果只读
+    if (ui->bookTableView->model() != m_bookModel) {
+        QMessageBox::warning(this, "操作错误", "检索结果不可直接删除，请先重置搜索！");
+        return;
+    }
+
+    // 获取选中行（可多选）
+    const QModelIndexList selectedRows = ui->bookTableView->selectionModel()->selectedRows(BookTable::BookId);
+    if (selectedRows.isEmpty()) {
         QMessageBox::warning(this, "操作错误", "请选择要删除的图书！");
         return;
     }
+    QStringList bookIds;
+    for (const QModelIndex& index : selectedRows) {
+        bookIds << index.data().toString();
+    }
 
     // 确认删除
-    if (QMessageBox::question(this, "确认删除", "确定要删除选中的图书吗？\n删除后关联的借阅记录也会被删除！",
+    if (QMessageBox::question(this, "确认删除",
+                              QString("确定要删除选中的 %1 种图书吗？\n删除后关联的借阅记录与预约也会被删除！")
+                                  .arg(bookIds.size()),
                               QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
         return;
     }
 
-    // 删除行并提交
-    m_bookModel->removeRow(currentIndex.row());
-    if (m_bookModel->submitAll()) {
-        QMessageBox::information(this, "成功", "删除图书成功！");
-        refreshBookList();
+    // 分块删除并显示进度；期间暂停轮询，结束后整表刷新一次
+    m_pollTimer->stop();
+    QProgressDialog progressDialog("正在删除图书……", "停止", 0, bookIds.size(), this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(PROGRESS_DELAY_MS);
+    const DatabaseManager::BulkDeleteResult result = DatabaseManager::getInstance().deleteBooks(
+        bookIds, [&progressDialog](int done, int) {
+            progressDialog.setValue(done);
+            return !progressDialog.wasCanceled();
+        });
+    progressDialog.reset();
+    m_pollTimer->start(CHANGE_POLL_INTERVAL_MS);
+    refreshBookList();
+
+    QString summary = QString("已删除 %1 种图书").arg(result.deleted);
+    if (result.skipped > 0) {
+        summary += QString("，%1 种有未还借阅或留书，未删除").arg(result.skipped);
+    }
+    if (result.ok) {
+        QMessageBox::information(this, "删除完成", summary + "。");
     } else {
-        QMessageBox::critical(this, "失败", "删除图书失败：" + m_bookModel->lastError().text());
-        m_bookModel->revertAll();
+        QMessageBox::critical(this, "失败", "删除图书未全部完成：" + summary + "。");
     }
 }
 
 void BookPanel::on_searchBookBtn_clicked()
 {
+    TRACE_SCOPE("ui", "BookPanel::on_searchBookBtn_clicked");
     const QString keyword = ui->bookSearchEdit->text().trimmed();
     if (keyword.isEmpty()) {
         QMessageBox::warning(this, "提示", "请输入搜索关键词！");
         return;
     }
 
+    // 多分馆：各分片并行检索并归并，结果只读展示
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    if (dbManager.shardCount() > 1) {
+        bool ok = false;
+        const QVector<DatabaseManager::BookRow> rows = dbManager.searchBooks(keyword, &ok);
+        if (!ok) {
+            QMessageBox::warning(this, "提示", "部分分馆检索失败，结果可能不完整！");
+        }
+
+        m_searchModel->clear();
+        m_searchModel->setHorizontalHeaderLabels(headerLabels<BookTable>() << "所属分馆");
+        for (const DatabaseManager::BookRow& row : rows) {
+            QList<QStandardItem*> items{
+                new QStandardItem(row.bookId), new QStandardItem(row.bookName),
+                new QStandardItem(row.author), new QStandardItem(row.category),
+                new QStandardItem(QString::number(row.stock)), new QStandardItem(QString::number(row.totalCopies)),
+                new QStandardItem(dbManager.branchName(row.shard))};
+            for (QStandardItem* item : items) {
+                item->setEditable(false);
+            }
+            m_searchModel->appendRow(items);
+        }
+        ui->bookTableView->setModel(m_searchModel);
+
+        QMessageBox::information(this, "搜索结果", QString("共找到 %1 条匹配记录").arg(rows.size()));
+        return;
+    }
+
     // 模糊搜索：图书编号/名称/作者/分类
     const QString filter = QString(
                                "book_id LIKE '%%1%' OR book_name LIKE '%%1%' OR author LIKE '%%1%' OR category LIKE '%%1%'"
                                ).arg(keyword);
     m_bookModel->setFilter(filter);
-    m_bookModel->select();
+    DatabaseManager::selectModel(m_bookModel);
 
     // 提示搜索结果数量
-    const int count = m_bookModel->rowCount();
+    const int count = DatabaseManager::countRows(m_bookModel);
     QMessageBox::information(this, "搜索结果", QString("共找到 %1 条匹配记录").arg(count));
 }
 
 void BookPanel::on_resetSearchBtn_clicked()
 {
+    TRACE_SCOPE("ui", "BookPanel::on_resetSearchBtn_clicked");
     // 清空筛选，恢复所有数据
+    ui->bookTableView->setModel(m_bookModel);
     m_bookModel->setFilter("");
-    m_bookModel->select();
+    DatabaseManager::selectModel(m_bookModel);
     ui->bookSearchEdit->clear();
 }
@@ -3,7 +3,11 @@
 
 #include <QWidget>
 #include <QSqlTableModel>
+#include <QTimer>
+#include <QStandardItemModel>
 #include "database_manager.h"
+#include "audit_log.h"
+#include "change_tracker.h"
 
 // 需在Qt Designer中创建bookpanel.ui，命名与代码一致
 namespace Ui {
@@ -24,13 +28,24 @@ public:
 private slots:
     // 按钮点击槽函数（与UI控件命名绑定）
     void on_addBookBtn_clicked();    // 新增图书
-    void on_delBookBtn_clicked();    // 删除图书
+    void on_delBookBtn_clicked();    // 删除选中图书（可多选）
     void on_searchBookBtn_clicked(); // 搜索图书
     void on_resetSearchBtn_clicked();// 重置搜索
 
+    void onPollChanges();            // 轮询其他终端的数据变更
+    void onDeferredSelect();         // 首屏以快照显示后，再查询实时数据
+
 private:
     Ui::BookPanel *ui;
     QSqlTableModel* m_bookModel; // 成员变量加m_前缀，避免命名冲突
+    AuditModelWatcher* m_bookAudit; // 提交时记录审计事件
+    ChangeTracker m_changeTracker; // 增量刷新游标
+    QTimer* m_pollTimer;
+    QStandardItemModel* m_searchModel; // 多分馆检索结果（只读）
+    CatalogBookModel* m_snapshotModel = nullptr; // 目录快照首屏（实时数据就绪后释放）
+
+    const int CHANGE_POLL_INTERVAL_MS = 2000; // 变更轮询周期
+    const int PROGRESS_DELAY_MS = 500;        // 批量删除超过此时长才弹出进度框
 };
 
 #endif // BOOKPANEL_H
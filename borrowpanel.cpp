@@ -1,34 +1,106 @@
 #include "borrowpanel.h"
 #include "ui_borrowpanel.h"
+#include "trace.h"
+#include "schema.h"
+#include "hold_queue.h"
+#include "overdue_scheduler.h"
+#include <QFile>
 #include <QMessageBox>
-#include <QFileDialog>
-#include <QDateTime>
+#include <QtConcurrent>
 
 BorrowPanel::BorrowPanel(QWidget *parent) :
     QWidget(parent),
-    ui(new Ui::BorrowPanel)
+    ui(new Ui::BorrowPanel),
+    m_changeTracker(BorrowTable::NAME, DatabaseManager::getInstance().currentShard())
 {
     ui->setupUi(this);
 
+    // 读者可在其他分馆预约：每个分片各跟踪一份预约表变更
+    for (const ShardInfo& shard : DatabaseManager::getInstance().shards()) {
+        m_holdTrackers.emplace_back(ReservationTable::NAME, shard.index);
+    }
+
     // 初始化模型
     m_borrowModel = DatabaseManager::getInstance().getBorrowModel(this);
     ui->borrowTableView->setModel(m_borrowModel);
     ui->borrowTableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     ui->borrowTableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ui->borrowTableView->setEditTriggers(QAbstractItemView::NoEditTriggers); // 只读连接，记录仅经借还修改
+
+    // 各分馆有效预约：每本书已留书的在前，等待中的按队列顺序
+    m_holdModel = DatabaseManager::getInstance().getReservationModel(this);
+    ui->holdTableView->setModel(m_holdModel);
+    ui->holdTableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    ui->holdTableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ui->holdTableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    // 定时轮询其他终端的提交，只刷新变动的行
+    m_pollTimer = new QTimer(this);
+    connect(m_pollTimer, &QTimer::timeout, this, &BorrowPanel::onPollChanges);
+    m_pollTimer->start(CHANGE_POLL_INTERVAL_MS);
+
+    // 订阅逾期事件
+    connect(&OverdueScheduler::getInstance(), &OverdueScheduler::loanOverdue,
+            this, &BorrowPanel::onLoanOverdue);
+    updateOverdueCount();
+
+    // 过期留书被清理后刷新预约队列
+    connect(&HoldQueue::getInstance(), &HoldQueue::holdsChanged, this, &BorrowPanel::refreshHoldList);
 }
 
 BorrowPanel::~BorrowPanel()
 {
+    // 导出尚未结束时让其尽快中止，工作线程不再引用面板后再析构
+    if (m_exportWatcher && m_exportWatcher->isRunning()) {
+        m_exportCanceled = true;
+        m_exportWatcher->waitForFinished();
+    }
     delete ui;
 }
 
 void BorrowPanel::refreshBorrowList()
 {
-    m_borrowModel->select();
+    TRACE_SCOPE("ui", "BorrowPanel::refreshBorrowList");
+    m_changeTracker.sync();
+    DatabaseManager::selectModel(m_borrowModel);
+}
+
+void BorrowPanel::refreshHoldList()
+{
+    TRACE_SCOPE("ui", "BorrowPanel::refreshHoldList");
+    for (ChangeTracker& tracker : m_holdTrackers) {
+        tracker.sync();
+    }
+    DatabaseManager::getInstance().refreshReservationModel(m_holdModel);
+}
+
+void BorrowPanel::onPollChanges()
+{
+    // 面板不可见时不刷新，切回时一次补齐
+    if (!isVisible()) {
+        return;
+    }
+    // 其他终端的借还、或其借阅随时间到期，都会改变逾期数
+    if (m_changeTracker.refreshModel(m_borrowModel, BorrowTable::Id)
+        || m_overdueCountAge.hasExpired(OVERDUE_RECOUNT_MS)) {
+        updateOverdueCount();
+    }
+
+    // 预约队列行数少且排序依赖多列，有变更即整体重查
+    // 每个分片都要轮询以推进各自的游标
+    bool holdsChanged = false;
+    for (ChangeTracker& tracker : m_holdTrackers) {
+        ChangeTracker::Changes changes;
+        holdsChanged = tracker.poll(&changes) || holdsChanged;
+    }
+    if (holdsChanged) {
+        DatabaseManager::getInstance().refreshReservationModel(m_holdModel);
+    }
 }
 
 void BorrowPanel::on_borrowBtn_clicked()
 {
+    TRACE_SCOPE("ui", "BorrowPanel::on_borrowBtn_clicked");
     const QString bookId = ui->borrowBookIdEdit->text().trimmed();
     const QString readerId = ui->borrowReaderIdEdit->text().trimmed();
 
@@ -41,9 +113,14 @@ void BorrowPanel::on_borrowBtn_clicked()
     if (DatabaseManager::getInstance().borrowBook(bookId, readerId)) {
         QMessageBox::information(this, "成功", "借书操作完成！");
         refreshBorrowList();
+        refreshHoldList();
         // 清空输入
         ui->borrowBookIdEdit->clear();
         ui->borrowReaderIdEdit->clear();
+    } else if (DatabaseManager::getInstance().lastOperationBusy()) {
+        QMessageBox::warning(this, "失败", "数据库繁忙（其他终端正在办理借还），请稍后重试！");
+    } else if (DatabaseManager::getInstance().lastBorrowOutOfStock()) {
+        offerReservation(bookId, readerId);
     } else {
         QMessageBox::critical(this, "失败", "借书失败！\n请检查：\n1. 图书编号是否存在\n2. 图书库存是否充足\n3. 读者编号是否存在");
     }
@@ -51,6 +128,7 @@ void BorrowPanel::on_borrowBtn_clicked()
 
 void BorrowPanel::on_returnBtn_clicked()
 {
+    TRACE_SCOPE("ui", "BorrowPanel::on_returnBtn_clicked");
     const QString borrowIdStr = ui->returnBorrowIdEdit->text().trimmed();
     if (borrowIdStr.isEmpty()) {
         QMessageBox::warning(this, "输入错误", "借阅记录ID不能为空！");
@@ -64,34 +142,121 @@ void BorrowPanel::on_returnBtn_clicked()
         return;
     }
 
-    // 调用还书逻辑
-    if (DatabaseManager::getInstance().returnBook(borrowId)) {
-        QMessageBox::information(this, "成功", "还书操作完成！");
+    // 调用还书逻辑（有人预约时副本直接留给队首读者）
+    DatabaseManager::HoldAssignment hold;
+    if (DatabaseManager::getInstance().returnBook(borrowId, &hold)) {
+        if (hold.reservationId > 0) {
+            QMessageBox::information(this, "成功", QString("还书操作完成！\n该书已为预约读者 %1 留书（预约ID：%2），请放至预约架。")
+                                                       .arg(hold.readerId).arg(hold.reservationId));
+        } else {
+            QMessageBox::information(this, "成功", "还书操作完成！");
+        }
         refreshBorrowList();
+        refreshHoldList();
+        updateOverdueCount();
         ui->returnBorrowIdEdit->clear();
+    } else if (DatabaseManager::getInstance().lastOperationBusy()) {
+        QMessageBox::warning(this, "失败", "数据库繁忙（其他终端正在办理借还），请稍后重试！");
     } else {
         QMessageBox::critical(this, "失败", "还书失败！\n请检查：\n1. 借阅ID是否存在\n2. 该记录是否已归还");
     }
 }
 
-void BorrowPanel::on_exportBorrowBtn_clicked()
+void BorrowPanel::offerReservation(const QString& bookId, const QString& readerId)
 {
-    // 选择保存路径（默认文件名带日期）
-    const QString defaultFileName = QString("借阅记录_%1.csv").arg(QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss"));
-    const QString filePath = QFileDialog::getSaveFileName(
-        this,
-        "导出借阅记录",
-        defaultFileName,
-        "CSV文件 (*.csv);;所有文件 (*.*)"
-        );
+    if (QMessageBox::question(this, "库存不足", "该书已全部借出，是否为该读者登记预约？\n有副本归还时将按预约顺序留书。",
+                              QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+        return;
+    }
 
+    int waitingCount = 0;
+    if (DatabaseManager::getInstance().reserveBook(bookId, readerId, &waitingCount)) {
+        QMessageBox::information(this, "成功", QString("预约登记完成！当前该书等待人数：%1").arg(waitingCount));
+        refreshHoldList();
+        ui->borrowBookIdEdit->clear();
+        ui->borrowReaderIdEdit->clear();
+    } else if (DatabaseManager::getInstance().lastOperationBusy()) {
+        QMessageBox::warning(this, "失败", "数据库繁忙（其他终端正在办理借还），请稍后重试！");
+    } else {
+        QMessageBox::critical(this, "失败", "预约失败！\n请检查：\n1. 读者编号是否存在\n2. 该读者是否已预约此书");
+    }
+}
+
+void BorrowPanel::on_cancelHoldBtn_clicked()
+{
+    TRACE_SCOPE("ui", "BorrowPanel::on_cancelHoldBtn_clicked");
+    const QModelIndex currentIndex = ui->holdTableView->currentIndex();
+    if (!currentIndex.isValid()) {
+        QMessageBox::warning(this, "操作错误", "请选择要取消的预约！");
+        return;
+    }
+    // 预约可能登记在其他分馆的分片（预约ID各分片独立编号）
+    const QModelIndex idIndex = m_holdModel->index(currentIndex.row(), ReservationQueueView::Id);
+    const int reservationId = idIndex.data().toInt();
+    const int shardIndex = idIndex.data(Qt::UserRole).toInt();
+
+    if (QMessageBox::question(this, "确认取消", "确定要取消选中的预约吗？\n已留出的副本将转给下一位预约读者。",
+                              QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
+        return;
+    }
+
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    if (dbManager.cancelReservation(shardIndex, reservationId)) {
+        refreshHoldList();
+    } else if (dbManager.lastOperationBusy()) {
+        QMessageBox::warning(this, "失败", "数据库繁忙（其他终端正在办理借还），请稍后重试！");
+    } else {
+        QMessageBox::critical(this, "失败", "取消预约失败！该预约可能已被取书或已结束。");
+        refreshHoldList();
+    }
+}
+
+void BorrowPanel::on_exportBorrowBtn_clicked()
+{
+    TRACE_SCOPE("ui", "BorrowPanel::on_exportBorrowBtn_clicked");
+    // 选择保存路径与导出格式（默认文件名带日期）
+    ExportFormat format = ExportFormat::Csv;
+    const QString filePath = FileExporter::getSaveFileName(this, "导出借阅记录", "借阅记录", &format);
     if (filePath.isEmpty()) {
         return;
     }
 
-    // 执行导出
-    if (FileExporter::exportBorrowRecords(filePath)) {
-        QMessageBox::information(this, "导出成功", QString("记录已导出至：\n%1").arg(filePath));
+    if (!m_exportWatcher) {
+        m_exportWatcher = new QFutureWatcher<bool>(this);
+        connect(m_exportWatcher, &QFutureWatcher<bool>::finished, this, &BorrowPanel::onExportFinished);
+        m_exportProgress = new QProgressDialog("正在导出借阅记录……", "停止", 0, 100, this);
+        m_exportProgress->setMinimumDuration(PROGRESS_DELAY_MS);
+        m_exportProgress->reset(); // 创建即开始计时弹出，等开始导出时再计时
+        connect(m_exportProgress, &QProgressDialog::canceled, this, [this]() { m_exportCanceled = true; });
+    }
+
+    // 在工作线程上导出（分片信息先在GUI线程取出），进度经队列连接回到界面，界面照常响应
+    const QVector<ShardInfo> shards = DatabaseManager::getInstance().shards();
+    m_exportPath = filePath;
+    m_exportCanceled = false;
+    ui->exportBorrowBtn->setEnabled(false);
+    m_exportProgress->setValue(0);
+    QProgressDialog* dialog = m_exportProgress;
+    std::atomic<bool>* canceled = &m_exportCanceled;
+    const FileExporter::ExportProgress progress = [dialog, canceled](qint64 written, qint64 total) {
+        const int percent = int(written * 100 / qMax<qint64>(1, total));
+        QMetaObject::invokeMethod(dialog, [dialog, percent]() { dialog->setValue(percent); }, Qt::QueuedConnection);
+        return !canceled->load();
+    };
+    m_exportWatcher->setFuture(QtConcurrent::run([shards, filePath, format, progress]() {
+        return FileExporter::exportBorrowRecords(shards, filePath, format, progress);
+    }));
+}
+
+void BorrowPanel::onExportFinished()
+{
+    m_exportProgress->reset();
+    ui->exportBorrowBtn->setEnabled(true);
+    if (m_exportCanceled) {
+        QFile::remove(m_exportPath); // 中止时只写了一部分
+        QMessageBox::information(this, "导出中止", "借阅记录导出已停止。");
+    } else if (m_exportWatcher->result()) {
+        QMessageBox::information(this, "导出成功", QString("记录已导出至：\n%1").arg(m_exportPath));
     } else {
         QMessageBox::critical(this, "导出失败", "无法导出借阅记录！\n请检查文件路径是否可写。");
     }
@@ -99,19 +264,52 @@ void BorrowPanel::on_exportBorrowBtn_clicked()
 
 void BorrowPanel::on_filterUnreturnedBtn_clicked()
 {
+    TRACE_SCOPE("ui", "BorrowPanel::on_filterUnreturnedBtn_clicked");
     // 筛选未归还的记录（return_time为空）
     m_borrowModel->setFilter("return_time IS NULL");
-    m_borrowModel->select();
+    DatabaseManager::selectModel(m_borrowModel);
 
-    const int count = m_borrowModel->rowCount();
+    const int count = DatabaseManager::countRows(m_borrowModel);
     QMessageBox::information(this, "筛选结果", QString("当前未归还记录：%1 条").arg(count));
 }
 
+void BorrowPanel::on_filterOverdueBtn_clicked()
+{
+    TRACE_SCOPE("ui", "BorrowPanel::on_filterOverdueBtn_clicked");
+    // 按应还时间筛选（走应还时间索引）：以库中状态为准，其他终端办理的借还同样计入
+    m_borrowModel->setFilter(QLatin1String(DatabaseManager::OVERDUE_FILTER));
+    DatabaseManager::selectModel(m_borrowModel);
+
+    const int count = DatabaseManager::countRows(m_borrowModel);
+    updateOverdueCount();
+    if (count == 0) {
+        QMessageBox::information(this, "筛选结果", "当前没有逾期记录");
+        return;
+    }
+    QMessageBox::information(this, "筛选结果", QString("当前逾期记录：%1 条").arg(count));
+}
+
+void BorrowPanel::onLoanOverdue(int borrowId)
+{
+    Q_UNUSED(borrowId);
+    updateOverdueCount();
+}
+
+void BorrowPanel::updateOverdueCount()
+{
+    // 与列表一致只计本馆分片；逾期事件只负责提醒，计数从库中统计
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    const int count = dbManager.overdueLoanCount(dbManager.currentShard());
+    m_overdueCountAge.start();
+    ui->filterOverdueBtn->setText(count > 0 ? QString("查看逾期(%1)").arg(count) : QString("查看逾期"));
+}
+
 void BorrowPanel::on_resetFilterBtn_clicked()
 {
+    TRACE_SCOPE("ui", "BorrowPanel::on_resetFilterBtn_clicked");
     // 重置筛选
     m_borrowModel->setFilter("");
-    m_borrowModel->select();
+    DatabaseManager::selectModel(m_borrowModel);
     QMessageBox::information(this, "提示", "已恢复显示所有借阅记录");
 }
 //提交,测试,格式优化
@@ -3,7 +3,15 @@
 
 #include <QWidget>
 #include <QSqlTableModel>
+#include <QStandardItemModel>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QProgressDialog>
+#include <atomic>
+#include <vector>
 #include "database_manager.h"
+#include "change_tracker.h"
 #include "file_exporter.h"
 
 namespace Ui {
@@ -21,16 +29,44 @@ public:
     // 刷新借阅列表
     void refreshBorrowList();
 
+    // 刷新预约队列
+    void refreshHoldList();
+
 public slots:
     void on_borrowBtn_clicked();          // 借书
     void on_returnBtn_clicked();          // 还书
     void on_exportBorrowBtn_clicked();    // 导出CSV
     void on_filterUnreturnedBtn_clicked();// 筛选未归还
+    void on_filterOverdueBtn_clicked();   // 筛选已逾期
     void on_resetFilterBtn_clicked();     // 重置筛选
+    void on_cancelHoldBtn_clicked();      // 取消预约
+
+private slots:
+    void onPollChanges();             // 轮询其他终端的数据变更
+    void onLoanOverdue(int borrowId);     // 逾期事件：更新逾期计数
+    void onExportFinished();              // 后台导出结束
 
 private:
+    void updateOverdueCount();
+    void offerReservation(const QString& bookId, const QString& readerId); // 库存不足时询问是否预约
+
     Ui::BorrowPanel *ui;
     QSqlTableModel* m_borrowModel;
+    QStandardItemModel* m_holdModel;
+    ChangeTracker m_changeTracker; // 增量刷新游标
+    std::vector<ChangeTracker> m_holdTrackers; // 各分片预约表的变更游标（任一有变更即重查队列）
+    QTimer* m_pollTimer;
+
+    QElapsedTimer m_overdueCountAge; // 逾期计数距上次统计的时长
+
+    QFutureWatcher<bool>* m_exportWatcher = nullptr; // 借阅导出在工作线程上执行
+    QProgressDialog* m_exportProgress = nullptr;
+    QString m_exportPath;
+    std::atomic<bool> m_exportCanceled{false}; // 工作线程在进度回调中读取
+
+    const int CHANGE_POLL_INTERVAL_MS = 2000; // 变更轮询周期
+    const int OVERDUE_RECOUNT_MS = 60 * 1000; // 无变更时逾期计数的重新统计周期（其他终端的借阅随时间到期）
+    const int PROGRESS_DELAY_MS = 500;        // 导出超过此时长才弹出进度框
 };
 
 #endif // BORROWPANEL_H
@@ -0,0 +1,354 @@
+#include "catalog_snapshot.h"
+#include "schema.h"
+#include "sqlite_reader.h"
+#include "trace.h"
+#include <QDebug>
+#include <QHash>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// 文件布局：Header | BookEntry[bookCount] | ReaderEntry[readerCount] | 字符串池
+// 字符串池中每个字符串为 quint32长度 + UTF-8字节，按4字节对齐；条目中的字符串以池内偏移引用
+const char MAGIC[8] = {'Z', 'H', 'X', 'M', 'C', 'A', 'T', '\0'};
+const quint32 FORMAT_VERSION = 3;
+const quint32 BYTE_ORDER_MARK = 0x01020304; // 按本机字节序写入，异机拷贝的文件直接判为无效
+
+struct Header {
+    char magic[8];
+    quint32 formatVersion;
+    quint32 byteOrderMark;
+    qint64 changeSeq;
+    quint32 bookCount;
+    quint32 readerCount;
+    quint64 bookOffset;
+    quint64 readerOffset;
+    quint64 stringOffset;
+    quint64 stringSize;
+};
+static_assert(sizeof(Header) == 64, "快照文件头布局变化须提升FORMAT_VERSION");
+
+struct BookEntry {
+    quint32 bookId;
+    quint32 bookName;
+    quint32 author;
+    quint32 category;
+    qint32 stock;
+    qint32 totalCopies;
+};
+static_assert(sizeof(BookEntry) == 24, "图书条目布局变化须提升FORMAT_VERSION");
+
+struct ReaderEntry {
+    quint32 readerId;
+    quint32 readerName;
+    quint32 phone;
+    qint32 priority;
+};
+static_assert(sizeof(ReaderEntry) == 16, "读者条目布局变化须提升FORMAT_VERSION");
+
+quint64 alignUp(quint64 value, quint64 alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// 字符串驻留：相同文本（作者、分类等重复值）只存一份
+class StringPool {
+public:
+    quint32 intern(std::string_view text) {
+        const QByteArray key(text.data(), int(text.size()));
+        const auto it = m_offsets.constFind(key);
+        if (it != m_offsets.constEnd()) {
+            return it.value();
+        }
+        const quint32 offset = quint32(m_data.size());
+        const quint32 length = quint32(text.size());
+        m_data.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        m_data.append(key);
+        m_data.append(int(alignUp(quint64(m_data.size()), 4) - quint64(m_data.size())), '\0');
+        m_offsets.insert(key, offset);
+        return offset;
+    }
+
+    std::string_view at(quint32 offset) const {
+        quint32 length = 0;
+        std::memcpy(&length, m_data.constData() + offset, sizeof(length));
+        return std::string_view(m_data.constData() + offset + sizeof(length), length);
+    }
+
+    const QByteArray& data() const { return m_data; }
+
+private:
+    QByteArray m_data;
+    QHash<QByteArray, quint32> m_offsets;
+};
+
+template <typename Entry, typename Key>
+int findEntry(const Entry* begin, int count, Key key, std::string_view id) {
+    const Entry* end = begin + count;
+    const Entry* it = std::lower_bound(begin, end, id, [&](const Entry& entry, std::string_view value) {
+        return key(entry) < value;
+    });
+    return (it != end && key(*it) == id) ? int(it - begin) : -1;
+}
+
+const Header* headerOf(const uchar* data) {
+    return reinterpret_cast<const Header*>(data);
+}
+
+} // namespace
+
+CatalogSnapshot::~CatalogSnapshot() {
+    close();
+}
+
+bool CatalogSnapshot::build(const QString& dbFilePath, const QString& snapshotPath) {
+    TRACE_SCOPE("db", "CatalogSnapshot::build");
+    // 读快照内取序号与两张表，保证快照内容与记录的序号一致
+    SqliteConnection conn;
+    if (!conn.open(dbFilePath) || !conn.beginSnapshot()) {
+        qWarning() << "生成目录快照失败：" << conn.errorMessage();
+        return false;
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.formatVersion = FORMAT_VERSION;
+    header.byteOrderMark = BYTE_ORDER_MARK;
+
+    SqliteStatement seqStmt(conn, "SELECT IFNULL(MAX(seq), 0) FROM change_log");
+    if (!seqStmt.step()) {
+        qWarning() << "读取变更日志失败：" << conn.errorMessage();
+        return false;
+    }
+    header.changeSeq = seqStmt.column<std::int64_t>(0);
+
+    StringPool pool;
+    std::vector<BookEntry> books;
+    const QByteArray bookSql = QString("SELECT %1 FROM %2").arg(columnListSql<BookTable>(), BookTable::NAME).toUtf8();
+    SqliteStatement bookStmt(conn, bookSql.constData());
+    BookCatalogRecord book;
+    while (bookStmt.step()) {
+        bookStmt.decode(book);
+        books.push_back({pool.intern(book.bookId), pool.intern(book.bookName), pool.intern(book.author),
+                         pool.intern(book.category), qint32(book.stock), qint32(book.totalCopies)});
+    }
+
+    std::vector<ReaderEntry> readers;
+    const QByteArray readerSql = QString("SELECT %1 FROM %2").arg(columnListSql<ReaderTable>(), ReaderTable::NAME).toUtf8();
+    SqliteStatement readerStmt(conn, readerSql.constData());
+    ReaderCatalogRecord reader;
+    while (readerStmt.step()) {
+        readerStmt.decode(reader);
+        readers.push_back({pool.intern(reader.readerId), pool.intern(reader.readerName), pool.intern(reader.phone),
+                           qint32(reader.priority)});
+    }
+    if (bookStmt.failed() || readerStmt.failed()) {
+        qWarning() << "读取目录失败：" << conn.errorMessage();
+        return false;
+    }
+
+    // 按编号字节序排序，查找时二分
+    std::sort(books.begin(), books.end(), [&pool](const BookEntry& a, const BookEntry& b) {
+        return pool.at(a.bookId) < pool.at(b.bookId);
+    });
+    std::sort(readers.begin(), readers.end(), [&pool](const ReaderEntry& a, const ReaderEntry& b) {
+        return pool.at(a.readerId) < pool.at(b.readerId);
+    });
+
+    header.bookCount = quint32(books.size());
+    header.readerCount = quint32(readers.size());
+    header.bookOffset = alignUp(sizeof(Header), 8);
+    header.readerOffset = header.bookOffset + books.size() * sizeof(BookEntry);
+    header.stringOffset = alignUp(header.readerOffset + readers.size() * sizeof(ReaderEntry), 8);
+    header.stringSize = quint64(pool.data().size());
+
+    QSaveFile file(snapshotPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "写入目录快照失败：" << file.errorString();
+        return false;
+    }
+    const QByteArray padding(8, '\0');
+    bool success = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header))
+            && file.write(padding.constData(), qint64(header.bookOffset - sizeof(header))) >= 0
+            && file.write(reinterpret_cast<const char*>(books.data()), qint64(books.size() * sizeof(BookEntry)))
+               == qint64(books.size() * sizeof(BookEntry))
+            && file.write(reinterpret_cast<const char*>(readers.data()), qint64(readers.size() * sizeof(ReaderEntry)))
+               == qint64(readers.size() * sizeof(ReaderEntry))
+            && file.write(padding.constData(),
+                          qint64(header.stringOffset - header.readerOffset - readers.size() * sizeof(ReaderEntry))) >= 0
+            && file.write(pool.data()) == pool.data().size();
+    if (!success || !file.commit()) {
+        qWarning() << "写入目录快照失败：" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool CatalogSnapshot::open(const QString& snapshotPath) {
+    TRACE_SCOPE("db", "CatalogSnapshot::open");
+    close();
+    m_file.setFileName(snapshotPath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size < qint64(sizeof(Header))) {
+        close();
+        return false;
+    }
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        qWarning() << "映射目录快照失败：" << m_file.errorString();
+        close();
+        return false;
+    }
+
+    // 校验文件头与各段边界（条目本身不解析，字符串引用在读取时做边界检查）
+    const Header* header = headerOf(m_data);
+    const quint64 size = quint64(m_size);
+    const bool valid = std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0
+            && header->formatVersion == FORMAT_VERSION
+            && header->byteOrderMark == BYTE_ORDER_MARK
+            && header->bookOffset % 8 == 0 && header->readerOffset % 8 == 0
+            && header->bookOffset + quint64(header->bookCount) * sizeof(BookEntry) <= header->readerOffset
+            && header->readerOffset + quint64(header->readerCount) * sizeof(ReaderEntry) <= header->stringOffset
+            && header->stringOffset <= size && header->stringSize <= size - header->stringOffset;
+    if (!valid) {
+        qWarning() << "目录快照格式无效，已忽略：" << snapshotPath;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CatalogSnapshot::close() {
+    if (m_data) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+        m_data = nullptr;
+    }
+    m_size = 0;
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+qint64 CatalogSnapshot::changeSeq() const {
+    return m_data ? headerOf(m_data)->changeSeq : -1;
+}
+
+int CatalogSnapshot::bookCount() const {
+    return m_data ? int(headerOf(m_data)->bookCount) : 0;
+}
+
+int CatalogSnapshot::readerCount() const {
+    return m_data ? int(headerOf(m_data)->readerCount) : 0;
+}
+
+std::string_view CatalogSnapshot::stringAt(quint32 ref) const {
+    const Header* header = headerOf(m_data);
+    if (quint64(ref) + sizeof(quint32) > header->stringSize) {
+        return std::string_view();
+    }
+    const uchar* base = m_data + header->stringOffset + ref;
+    quint32 length = 0;
+    std::memcpy(&length, base, sizeof(length));
+    if (quint64(ref) + sizeof(quint32) + length > header->stringSize) {
+        return std::string_view();
+    }
+    return std::string_view(reinterpret_cast<const char*>(base + sizeof(quint32)), length);
+}
+
+int CatalogSnapshot::findBook(const QString& bookId) const {
+    if (!m_data) {
+        return -1;
+    }
+    const QByteArray key = bookId.toUtf8();
+    const auto* entries = reinterpret_cast<const BookEntry*>(m_data + headerOf(m_data)->bookOffset);
+    return findEntry(entries, bookCount(), [this](const BookEntry& entry) { return stringAt(entry.bookId); },
+                     std::string_view(key.constData(), std::size_t(key.size())));
+}
+
+int CatalogSnapshot::findReader(const QString& readerId) const {
+    if (!m_data) {
+        return -1;
+    }
+    const QByteArray key = readerId.toUtf8();
+    const auto* entries = reinterpret_cast<const ReaderEntry*>(m_data + headerOf(m_data)->readerOffset);
+    return findEntry(entries, readerCount(), [this](const ReaderEntry& entry) { return stringAt(entry.readerId); },
+                     std::string_view(key.constData(), std::size_t(key.size())));
+}
+
+QVariant CatalogSnapshot::bookValue(int row, int column) const {
+    if (row < 0 || row >= bookCount()) {
+        return QVariant();
+    }
+    const BookEntry& entry = reinterpret_cast<const BookEntry*>(m_data + headerOf(m_data)->bookOffset)[row];
+    quint32 ref = 0;
+    switch (column) {
+    case BookTable::BookId: ref = entry.bookId; break;
+    case BookTable::BookName: ref = entry.bookName; break;
+    case BookTable::Author: ref = entry.author; break;
+    case BookTable::Category: ref = entry.category; break;
+    case BookTable::Stock: return entry.stock;
+    case BookTable::TotalCopies: return entry.totalCopies;
+    default: return QVariant();
+    }
+    const std::string_view text = stringAt(ref);
+    return QString::fromUtf8(text.data(), int(text.size()));
+}
+
+QVariant CatalogSnapshot::readerValue(int row, int column) const {
+    if (row < 0 || row >= readerCount()) {
+        return QVariant();
+    }
+    const ReaderEntry& entry = reinterpret_cast<const ReaderEntry*>(m_data + headerOf(m_data)->readerOffset)[row];
+    quint32 ref = 0;
+    switch (column) {
+    case ReaderTable::ReaderId: ref = entry.readerId; break;
+    case ReaderTable::ReaderName: ref = entry.readerName; break;
+    case ReaderTable::Phone: ref = entry.phone; break;
+    case ReaderTable::Priority: return entry.priority;
+    default: return QVariant();
+    }
+    const std::string_view text = stringAt(ref);
+    return QString::fromUtf8(text.data(), int(text.size()));
+}
+
+CatalogBookModel::CatalogBookModel(const CatalogSnapshot* snapshot, QObject* parent)
+    : QAbstractTableModel(parent), m_snapshot(snapshot) {
+    m_snapshot->retain();
+}
+
+CatalogBookModel::~CatalogBookModel() {
+    m_snapshot->release();
+}
+
+int CatalogBookModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : m_snapshot->bookCount();
+}
+
+int CatalogBookModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : BookTable::ColumnCount;
+}
+
+QVariant CatalogBookModel::data(const QModelIndex& index, int role) const {
+    // 只在显示时按需解码当前可见单元格
+    if (!index.isValid() || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+    return m_snapshot->bookValue(index.row(), index.column());
+}
+
+QVariant CatalogBookModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < BookTable::ColumnCount) {
+        return QString::fromUtf8(BookTable::COLUMNS[section].label);
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+Qt::ItemFlags CatalogBookModel::flags(const QModelIndex& index) const {
+    return index.isValid() ? Qt::ItemIsSelectable | Qt::ItemIsEnabled : Qt::NoItemFlags;
+}
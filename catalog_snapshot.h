@@ -0,0 +1,76 @@
+#ifndef CATALOG_SNAPSHOT_H
+#define CATALOG_SNAPSHOT_H
+
+#include <QAbstractTableModel>
+#include <QFile>
+#include <QString>
+#include <QVariant>
+#include <cstdint>
+#include <string_view>
+
+// 馆藏目录快照：图书/读者表的只读二进制镜像（按编号排序的定长条目 + 去重字符串池）。
+// 启动时内存映射，按编号查找和图书面板首屏直接读映射内存，不经SQL与QVariant解码；
+// 文件记录生成时变更日志的序号，此后图书/读者有增删即不能再用于查找，只有内容改动时不能再作首屏（由DatabaseManager判定并在后台重建）
+class CatalogSnapshot {
+public:
+    CatalogSnapshot() = default;
+    ~CatalogSnapshot();
+
+    CatalogSnapshot(const CatalogSnapshot&) = delete;
+    CatalogSnapshot& operator=(const CatalogSnapshot&) = delete;
+
+    // 在读快照内读取分片数据库的图书/读者表，生成快照文件（先写临时文件再替换）
+    static bool build(const QString& dbFilePath, const QString& snapshotPath);
+
+    // 映射快照文件（只校验文件头与各段边界，不解析条目）
+    bool open(const QString& snapshotPath);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    // 首屏模型引用计数（仅界面线程）：有模型在读取时不能解除映射换入新快照
+    void retain() const { ++m_users; }
+    void release() const { --m_users; }
+    bool inUse() const { return m_users > 0; }
+
+    // 生成时变更日志的最大序号
+    qint64 changeSeq() const;
+
+    int bookCount() const;
+    int readerCount() const;
+
+    // 按编号二分查找，返回条目序号（未找到返回-1）
+    int findBook(const QString& bookId) const;
+    int findReader(const QString& readerId) const;
+
+    // 条目字段（column为BookTable/ReaderTable列序号）
+    QVariant bookValue(int row, int column) const;
+    QVariant readerValue(int row, int column) const;
+
+private:
+    std::string_view stringAt(quint32 ref) const;
+
+    QFile m_file;
+    const uchar* m_data = nullptr;
+    qint64 m_size = 0;
+    mutable int m_users = 0;
+};
+
+// 目录快照上的只读图书模型（图书面板首屏使用，实时模型查询完成后替换）
+class CatalogBookModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    explicit CatalogBookModel(const CatalogSnapshot* snapshot, QObject* parent = nullptr);
+    ~CatalogBookModel() override;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+private:
+    const CatalogSnapshot* m_snapshot;
+};
+
+#endif // CATALOG_SNAPSHOT_H
@@ -0,0 +1,121 @@
+#include "change_tracker.h"
+#include "database_manager.h"
+#include "trace.h"
+#include <QHash>
+#include <QSet>
+
+ChangeTracker::ChangeTracker(const QString& table, int shardIndex)
+    : m_table(table), m_shardIndex(shardIndex) {
+    sync();
+}
+
+void ChangeTracker::sync() {
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    // 先取data_version再取游标：两者之间的提交会让下次轮询再读一遍，不会漏掉
+    m_dataVersion = dbManager.dataVersion(m_shardIndex);
+    const qint64 latest = dbManager.latestChangeSeq(m_shardIndex);
+    if (latest >= 0) {
+        m_cursor = latest;
+    }
+}
+
+bool ChangeTracker::poll(Changes* changes) {
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    const qint64 version = dbManager.dataVersion(m_shardIndex);
+    if (version < 0 || version == m_dataVersion) {
+        return false;
+    }
+
+    TRACE_SCOPE("db", "ChangeTracker::poll");
+    QVector<DatabaseManager::ChangeEntry> entries;
+    qint64 oldestSeq = 0;
+    if (!dbManager.readChanges(m_shardIndex, m_table, m_cursor, MAX_BATCH + 1, &entries, &oldestSeq)) {
+        return false; // 保留旧版本号，下次轮询重试
+    }
+    m_dataVersion = version;
+
+    changes->fullReload = false;
+    changes->updatedKeys.clear();
+    changes->insertedKeys.clear();
+
+    // 游标之后的日志已被清理，无法得知漏掉了哪些行
+    if (oldestSeq > m_cursor + 1) {
+        changes->fullReload = true;
+    }
+    if (entries.size() > MAX_BATCH) {
+        changes->fullReload = true;
+    }
+    if (changes->fullReload) {
+        const qint64 latest = dbManager.latestChangeSeq(m_shardIndex);
+        if (latest >= 0) {
+            m_cursor = latest;
+        }
+        return true;
+    }
+    if (entries.isEmpty()) {
+        return false; // 其他表的提交
+    }
+
+    QSet<QString> seen;
+    QSet<QString> inserted;
+    for (const DatabaseManager::ChangeEntry& entry : entries) {
+        if (entry.op == QLatin1Char('D')) {
+            changes->fullReload = true;
+        } else if (entry.op == QLatin1Char('I')) {
+            if (!inserted.contains(entry.rowKey)) {
+                inserted.insert(entry.rowKey);
+                changes->insertedKeys.append(entry.rowKey);
+            }
+        } else if (!seen.contains(entry.rowKey)) {
+            seen.insert(entry.rowKey);
+            changes->updatedKeys.append(entry.rowKey);
+        }
+    }
+    m_cursor = entries.last().seq;
+    return true;
+}
+
+bool ChangeTracker::refreshModel(QSqlTableModel* model, int keyColumn) {
+    // 有未提交的编辑时刷新会丢弃用户输入
+    if (model->isDirty()) {
+        return false;
+    }
+
+    Changes changes;
+    if (!poll(&changes)) {
+        return false;
+    }
+
+    TRACE_SCOPE("model", "ChangeTracker::refreshModel");
+    // 带筛选条件时更新可能使行进入或移出结果集，只能重新查询（按需读取，只取首批行）
+    if (changes.fullReload || !model->filter().isEmpty()) {
+        return DatabaseManager::selectModel(model);
+    }
+
+    // QSqlTableModel不能按主键插入行，未读完的游标也看不到新提交：重新查询，
+    // 只取回视图原有的行数（已读到末尾时再加上新增行），代价与已显示的行数相当，与表大小无关，已显示的行不会收缩
+    if (!changes.insertedKeys.isEmpty()) {
+        const int wanted = model->rowCount() + (model->canFetchMore() ? 0 : changes.insertedKeys.size());
+        if (!DatabaseManager::selectModel(model)) {
+            return false;
+        }
+        while (model->rowCount() < wanted && model->canFetchMore()) {
+            model->fetchMore();
+        }
+        return true;
+    }
+
+    QHash<QString, int> rowOfKey;
+    const int rowCount = model->rowCount();
+    rowOfKey.reserve(rowCount);
+    for (int row = 0; row < rowCount; ++row) {
+        rowOfKey.insert(model->data(model->index(row, keyColumn)).toString(), row);
+    }
+    for (const QString& key : changes.updatedKeys) {
+        const auto it = rowOfKey.constFind(key);
+        if (it != rowOfKey.constEnd()) {
+            model->selectRow(it.value()); // 按主键只重读这一行
+        }
+    }
+    return true;
+}
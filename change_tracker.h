@@ -0,0 +1,39 @@
+#ifndef CHANGE_TRACKER_H
+#define CHANGE_TRACKER_H
+
+#include <QSqlTableModel>
+#include <QString>
+#include <QStringList>
+
+// 数据变更跟踪：以PRAGMA data_version廉价探测其他终端的提交，
+// 有变化时按游标读取变更日志，只刷新变动的行（新增时重读到原有行数，删除时重新查询，均不整表读取）
+class ChangeTracker {
+public:
+    // 自上次同步以来的变更
+    struct Changes {
+        bool fullReload = false;  // 含删除，或游标已落后于日志保留范围
+        QStringList updatedKeys;  // 仅内容更新的行主键（已去重）
+        QStringList insertedKeys; // 新增行主键（已去重）
+    };
+
+    ChangeTracker(const QString& table, int shardIndex);
+
+    // 将游标同步到最新（整表刷新前调用，刷新期间的提交会在下次轮询时再次应用）
+    void sync();
+
+    // 轮询变更：数据未变化返回false
+    bool poll(Changes* changes);
+
+    // 轮询并应用到模型：未提交编辑时跳过（下次轮询再处理），返回是否刷新了模型
+    bool refreshModel(QSqlTableModel* model, int keyColumn);
+
+private:
+    QString m_table;
+    int m_shardIndex;
+    qint64 m_dataVersion = -1;
+    qint64 m_cursor = 0;
+
+    static const int MAX_BATCH = 500; // 单次变更超过此数直接整表刷新
+};
+
+#endif // CHANGE_TRACKER_H
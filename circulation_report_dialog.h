@@ -0,0 +1,33 @@
+#ifndef CIRCULATION_REPORT_DIALOG_H
+#define CIRCULATION_REPORT_DIALOG_H
+
+#include <QComboBox>
+#include <QDateEdit>
+#include <QDialog>
+#include <QLabel>
+#include <QSpinBox>
+#include <QTableWidget>
+
+// 流通统计报表：按日/周/月列出借出、归还、分类分布与热门图书（只读日桶，不扫描借阅记录）
+class CirculationReportDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit CirculationReportDialog(QWidget* parent = nullptr);
+
+private slots:
+    void runReport();
+
+private:
+    QDateEdit* m_fromEdit;
+    QDateEdit* m_toEdit;
+    QComboBox* m_granularityBox;
+    QSpinBox* m_topSpinBox;
+    QTableWidget* m_resultTable;
+    QLabel* m_statusLabel;
+
+    const int DEFAULT_RANGE_DAYS = 30; // 默认统计最近30天
+    const int DEFAULT_TOP_N = 10;
+};
+
+#endif // CIRCULATION_REPORT_DIALOG_H
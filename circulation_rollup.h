@@ -0,0 +1,129 @@
+#ifndef CIRCULATION_ROLLUP_H
+#define CIRCULATION_ROLLUP_H
+
+#include <QByteArray>
+#include <QDate>
+#include <QHash>
+#include <QSqlDatabase>
+#include <QStringList>
+#include <QVector>
+#include "database_manager.h"
+#include <atomic>
+#include <string_view>
+
+class SqliteConnection;
+
+// 静态工具类：流通趋势汇总
+// 日桶（circulation_daily）由借阅表触发器随借还事务累加；历史数据在读快照上按借阅ID区间并行扫描，
+// 只在写回差额时短暂取写锁；
+// 任意区间的日/周/月报表只合并日桶，不扫描借阅记录
+class CirculationRollup {
+public:
+    enum class Granularity { Day, Week, Month };
+
+    struct CategoryCount {
+        QString category;
+        qint64 borrows = 0;
+        qint64 returns = 0;
+    };
+
+    struct TitleCount {
+        QString bookId;
+        QString bookName;
+        qint64 borrows = 0;
+    };
+
+    // 一个统计周期（首末周期按查询区间截断）
+    struct Period {
+        QDate start;
+        QDate end;      // 含
+        QString label;
+        qint64 borrows = 0;
+        qint64 returns = 0;
+        QVector<CategoryCount> categories; // 按借出次数降序
+        QVector<TitleCount> topTitles;     // 借出次数前N名
+    };
+
+    // 区间报表：各分片并行读取[from, to]内的日桶并按周期合并
+    static bool report(const QVector<ShardInfo>& shards, const QDate& from, const QDate& to,
+                       Granularity granularity, int topN, QVector<Period>* periods);
+
+    // 重建单个分片的日桶：不取写锁，在同一提交版本上读出现有日桶并并行扫描借阅记录，
+    // 再以短写事务把两者的差额累加到汇总表（扫描期间触发器累加的计数原样保留）；
+    // 使用独立连接，可在工作线程上执行
+    static bool rebuild(const ShardInfo& shard, qint64* bucketCount = nullptr);
+
+    // 汇总表为空而已有借阅记录时回填（首次升级到带汇总表的版本；在工作线程上执行）
+    static bool backfillIfEmpty(const ShardInfo& shard);
+
+    // 让进行中的重建尽快放弃（退出程序前调用，未写回的差额下次启动重新扫描）
+    static void cancelRebuild() { s_cancelled.store(true, std::memory_order_relaxed); }
+
+    // 日期所在周期的第一天（周从周一开始）
+    static QDate periodStart(const QDate& day, Granularity granularity);
+
+    // 判断命令行是否为汇总命令（需在创建QApplication前判断）
+    static bool isCommand(int argc, char* argv[]);
+
+    // 命令行：--rollup-report 输出区间报表，--rollup-rebuild 重建日桶；返回进程退出码
+    static int runCommand(const QStringList& arguments);
+
+private:
+    CirculationRollup() = default;
+    ~CirculationRollup() = default;
+
+    // 回填区间：借阅ID [lower, upper)
+    struct IdRange {
+        ShardInfo shard;
+        qint64 lower;
+        qint64 upper;
+    };
+
+    struct Bucket {
+        QByteArray day;
+        QByteArray bookId;
+        QByteArray category;
+        qint64 borrows = 0;
+        qint64 returns = 0;
+    };
+    using BucketMap = QHash<QByteArray, Bucket>; // 键：日期 + '\0' + 图书编号
+
+    struct RangeResult {
+        BucketMap buckets;
+        qint64 logSeq = -1; // 扫描所在快照的变更日志序号（各区间相同才是同一提交版本）
+        bool ok = false;
+    };
+
+    // 单周期的合并中间结果
+    struct PeriodAccum {
+        qint64 borrows = 0;
+        qint64 returns = 0;
+        QHash<QString, CategoryCount> categories;
+        QHash<QString, TitleCount> titles;
+    };
+
+    struct ShardResult {
+        QVector<PeriodAccum> periods;
+        bool ok = false;
+    };
+
+    static RangeResult aggregateRange(const IdRange& range);
+    static bool scanRange(SqliteConnection& conn, const IdRange& range, RangeResult* result);
+    static bool scanDelta(const ShardInfo& shard, BucketMap* delta, qint64* snapshotSeq, qint64* scannedCount);
+    static bool applyDelta(const ShardInfo& shard, const BucketMap& delta, qint64 snapshotSeq, bool* conflict);
+    static bool countInto(SqliteConnection& conn, BucketMap& buckets, const QByteArray& sql, const IdRange& range,
+                          bool returns);
+    static Bucket& bucketAt(BucketMap& buckets, std::string_view day, std::string_view bookId,
+                            std::string_view category);
+    static void mergeInto(BucketMap& into, const BucketMap& from, int sign);
+    static ShardResult readShard(const ShardInfo& shard, const QDate& from, const QDate& to,
+                                 const QHash<QDate, int>& periodIndex, Granularity granularity);
+
+    static constexpr qint64 MIN_ROWS_PER_PARTITION = 50000; // 回填区间过小时并行收益不抵开销
+    static constexpr int PARALLEL_SCAN_ATTEMPTS = 3; // 各区间快照不一致时重扫的次数，之后在单个快照上串行扫描
+    static constexpr int APPLY_ATTEMPTS = 3;         // 写回时发现另一次重建已先写回，重新扫描的次数
+
+    static std::atomic<bool> s_cancelled;
+};
+
+#endif // CIRCULATION_ROLLUP_H
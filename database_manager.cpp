@@ -1,9 +1,256 @@
 #include "database_manager.h"
+#include "audit_log.h"
+#include "circulation_rollup.h"
+#include "hold_queue.h"
+#include "overdue_scheduler.h"
+#include "schema.h"
+#include "trace.h"
+#include "sqlite_reader.h"
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QRandomGenerator>
+#include <QSqlRecord>
+#include <QEventLoop>
+#include <QTimer>
+#include <QtConcurrent>
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+namespace {
+
+// 多路归并：各分片结果已按同一规则排序，借助小顶堆合并为整体有序序列
+template <typename T, typename Less>
+QVector<T> mergeSortedParts(QVector<QVector<T>>& parts, Less less) {
+    int total = 0;
+    for (const QVector<T>& part : parts) {
+        total += part.size();
+    }
+    QVector<T> merged;
+    merged.reserve(total);
+
+    using Cursor = std::pair<int, int>; // (分片下标, 行下标)
+    auto greater = [&](const Cursor& a, const Cursor& b) {
+        return less(parts[b.first][b.second], parts[a.first][a.second]);
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(greater)> heap(greater);
+    for (int i = 0; i < parts.size(); ++i) {
+        if (!parts[i].isEmpty()) {
+            heap.push({i, 0});
+        }
+    }
+    while (!heap.empty()) {
+        const Cursor top = heap.top();
+        heap.pop();
+        merged.append(std::move(parts[top.first][top.second]));
+        if (top.second + 1 < parts[top.first].size()) {
+            heap.push({top.first, top.second + 1});
+        }
+    }
+    return merged;
+}
+
+// 退避等待：在局部事件循环里等待，界面照常重绘、定时器照常触发；屏蔽用户输入，避免同一操作被重复点击重入
+void waitInEventLoop(int ms) {
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+}
+
+// 连接忙等待超时（PRAGMA busy_timeout）：作用域内改为指定值，离开时恢复
+class BusyTimeoutScope {
+public:
+    BusyTimeoutScope(QSqlDatabase& db, int restoreMs) : m_db(db), m_restoreMs(restoreMs) {}
+    ~BusyTimeoutScope() { set(m_restoreMs); }
+
+    void set(int ms) {
+        QSqlQuery query(m_db);
+        query.exec(QString("PRAGMA busy_timeout = %1").arg(ms));
+    }
+
+private:
+    QSqlDatabase& m_db;
+    int m_restoreMs;
+};
+
+} // namespace
+
+QAtomicInt ScopedConnection::s_activeSnapshots;
+
+ScopedConnection::ScopedConnection(const QString& filePath, bool readOnly) {
+    static QAtomicInt counter;
+    m_name = QString("library_scoped_conn_%1").arg(counter.fetchAndAddRelaxed(1));
+    m_db = QSqlDatabase::addDatabase("QSQLITE", m_name);
+    m_db.setDatabaseName(filePath);
+    if (readOnly) {
+        m_db.setConnectOptions("QSQLITE_OPEN_READONLY");
+    }
+    if (!m_db.open()) {
+        qCritical() << "打开分片连接失败：" << filePath << m_db.lastError().text();
+        return;
+    }
+    if (readOnly) {
+        QSqlQuery query(m_db);
+        query.exec("PRAGMA query_only = 1");
+    }
+    DatabaseManager::getInstance().storageProfile().applyConnection(m_db, !readOnly);
+}
+
+ScopedConnection::~ScopedConnection() {
+    if (m_inSnapshot) {
+        m_db.rollback();
+        s_activeSnapshots.deref();
+    }
+    m_db.close();
+    m_db = QSqlDatabase(); // 释放引用后才能移除连接
+    QSqlDatabase::removeDatabase(m_name);
+}
+
+bool ScopedConnection::beginSnapshot() {
+    if (m_inSnapshot || !m_db.isOpen()) {
+        return m_inSnapshot;
+    }
+    if (!m_db.transaction()) {
+        qCritical() << "开启读快照失败：" << m_db.lastError().text();
+        return false;
+    }
+    m_inSnapshot = true;
+    s_activeSnapshots.ref();
+    return true;
+}
+
+DatabaseManager::DatabaseManager() {
+    setStorageProfile(*m_storageProfile);
+}
+
+void DatabaseManager::setStorageProfile(const StorageProfile& profile) {
+    m_storageProfile = &profile;
+}
+
+QString DatabaseManager::shardConnectionName(int shardIndex) const {
+    // 总馆沿用原连接名，兼容旧代码
+    return shardIndex == 0 ? CONNECTION_NAME : QString("%1_%2").arg(CONNECTION_NAME).arg(shardIndex);
+}
 
 QSqlDatabase DatabaseManager::getDatabase() {
+    return getShardDatabase(m_currentShard);
+}
+
+QString DatabaseManager::shardFilePath(int shardIndex) const {
+    for (const ShardInfo& shard : m_shards) {
+        if (shard.index == shardIndex) {
+            return shard.filePath;
+        }
+    }
+    return m_databasePath;
+}
+
+bool DatabaseManager::configureWriter(QSqlDatabase& db) {
+    // WAL：读不阻塞写，写不阻塞读；只读连接据此获得一致快照（各存储配置档均为WAL，差别在同步级别与缓存）
+    if (!m_storageProfile->applyWriter(db)) {
+        return false;
+    }
+    // 检查点完成后把WAL文件截回上限以内，防止长期膨胀
+    QSqlQuery query(db);
+    query.exec(QString("PRAGMA journal_size_limit = %1").arg(WAL_SIZE_LIMIT));
+    return true;
+}
+
+QSqlDatabase DatabaseManager::getReadDatabase(int shardIndex) {
+    const QString connectionName = shardConnectionName(shardIndex) + "_ro";
+    if (QSqlDatabase::contains(connectionName)) {
+        QSqlDatabase db = QSqlDatabase::database(connectionName);
+        if (!db.isOpen() && !db.open()) {
+            qCritical() << "只读连接重连失败：" << db.lastError().text();
+            return QSqlDatabase();
+        }
+        return db;
+    }
+
+    // 确保写连接已建立（WAL模式及-shm文件由写连接创建）
+    if (!getShardDatabase(shardIndex).isOpen()) {
+        return QSqlDatabase();
+    }
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    db.setDatabaseName(shardFilePath(shardIndex));
+    db.setConnectOptions("QSQLITE_OPEN_READONLY");
+    if (!db.open()) {
+        qCritical() << "打开只读连接失败：" << db.lastError().text();
+        return QSqlDatabase();
+    }
+    QSqlQuery query(db);
+    query.exec("PRAGMA query_only = 1");
+    m_storageProfile->applyConnection(db, false);
+    return db;
+}
+
+bool DatabaseManager::selectModel(QSqlTableModel* model) {
+    TRACE_SCOPE("model", "DatabaseManager::selectModel");
+    // 大表不在界面线程上一次读完，后续行由视图滚动时fetchMore
+    return model->select();
+}
+
+int DatabaseManager::countRows(QSqlTableModel* model) {
+    TRACE_SCOPE("model", "DatabaseManager::countRows");
+    QString sql = QString("SELECT COUNT(*) FROM %1").arg(model->tableName());
+    if (!model->filter().isEmpty()) {
+        sql += QString(" WHERE %1").arg(model->filter());
+    }
+    QSqlQuery query(model->database());
+    if (!query.exec(sql) || !query.next()) {
+        qWarning() << "统计行数失败：" << query.lastError().text();
+        return model->rowCount();
+    }
+    return query.value(0).toInt();
+}
+
+void DatabaseManager::runScheduledCheckpoint() {
+    TRACE_SCOPE("db", "DatabaseManager::runScheduledCheckpoint");
+    // 截断须等读者读完、清理日志须取写锁，都可能等到忙等待超时：在工作线程上以独立连接执行，不阻塞界面
+    // 上一轮仍未结束时跳过本轮
+    if (!m_checkpointRunning.testAndSetAcquire(0, 1)) {
+        return;
+    }
+
+    // 有读快照时截断会等待读者，改为被动检查点，待读者结束后再截断
+    const bool readersActive = ScopedConnection::activeSnapshots() > 0;
+    const QVector<ShardInfo> shards = m_shards;
+    QtConcurrent::run([this, shards, readersActive]() {
+        TRACE_SCOPE("db", "DatabaseManager::checkpointWorker");
+        for (const ShardInfo& shard : shards) {
+            ScopedConnection conn(shard.filePath);
+            if (!conn.isOpen()) {
+                continue;
+            }
+
+            pruneChangeLog(conn.database());
+
+            const QFileInfo walInfo(shard.filePath + "-wal");
+            if (!walInfo.exists() || walInfo.size() == 0) {
+                continue;
+            }
+            QSqlQuery query(conn.database());
+            const QString mode = readersActive ? "PASSIVE" : "TRUNCATE";
+            if (!query.exec(QString("PRAGMA wal_checkpoint(%1)").arg(mode))) {
+                qWarning() << "WAL检查点失败：" << shard.branch << query.lastError().text();
+            }
+        }
+        m_checkpointRunning.storeRelease(0);
+    });
+}
+
+QSqlDatabase DatabaseManager::getShardDatabase(int shardIndex) {
+    const QString connectionName = shardConnectionName(shardIndex);
+
     // 检查连接是否已存在，避免重复创建
-    if (QSqlDatabase::contains(CONNECTION_NAME)) {
-        QSqlDatabase db = QSqlDatabase::database(CONNECTION_NAME);
+    if (QSqlDatabase::contains(connectionName)) {
+        QSqlDatabase db = QSqlDatabase::database(connectionName);
         // 若连接断开，重新打开
         if (!db.isOpen()) {
             if (!db.open()) {
@@ -14,235 +261,1606 @@ QSqlDatabase DatabaseManager::getDatabase() {
         return db;
     }
 
-    // 创建新连接
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", CONNECTION_NAME);
-    db.setDatabaseName(DB_NAME);
+    // 创建新连接（忙等待超时：锁被其他进程占用时由SQLite先自行等待）
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    db.setDatabaseName(shardFilePath(shardIndex));
+    db.setConnectOptions(QString("QSQLITE_BUSY_TIMEOUT=%1").arg(m_busyTimeoutMs));
 
     // 打开数据库
     if (!db.open()) {
         qCritical() << "数据库初始化失败：" << db.lastError().text();
         return QSqlDatabase();
     }
+    if (!configureWriter(db)) {
+        db.close();
+        return QSqlDatabase();
+    }
+
+    return db;
+}
+
+bool DatabaseManager::loadShards() {
+    m_shards.clear();
+    m_shards.append({0, MAIN_BRANCH, m_databasePath});
+
+    // 分馆分片文件与总馆库位于同一目录，分馆名称记录在各分片的shard_meta表中
+    const QFileInfo mainInfo(m_databasePath);
+    const QDir dir = mainInfo.absoluteDir();
+    const QStringList files = dir.entryList({SHARD_FILE_PREFIX + "*.db"}, QDir::Files, QDir::Name);
+    for (const QString& fileName : files) {
+        bool ok = false;
+        const int index = fileName.mid(SHARD_FILE_PREFIX.size()).chopped(3).toInt(&ok);
+        if (!ok || index <= 0) {
+            continue;
+        }
+
+        const QString filePath = dir.filePath(fileName);
+        QString branch = QString("分馆%1").arg(index);
+        {
+            ScopedConnection conn(filePath, true);
+            if (!conn.isOpen()) {
+                return false;
+            }
+            QSqlQuery query(conn.database());
+            if (query.exec("SELECT value FROM shard_meta WHERE key = 'branch'") && query.next()) {
+                branch = query.value(0).toString();
+            }
+        }
+        m_shards.append({index, branch, filePath});
+    }
+
+    std::sort(m_shards.begin(), m_shards.end(), [](const ShardInfo& a, const ShardInfo& b) {
+        return a.index < b.index;
+    });
+    return true;
+}
+
+bool DatabaseManager::addBranch(const QString& branch) {
+    for (const ShardInfo& shard : m_shards) {
+        if (shard.branch == branch) {
+            qWarning() << "分馆已存在：" << branch;
+            return false;
+        }
+    }
+
+    const int index = m_shards.isEmpty() ? 1 : m_shards.last().index + 1;
+    if (qint64(index + 1) * SHARD_ID_SPAN > std::numeric_limits<int>::max()) {
+        qCritical() << "分片数量已达上限";
+        return false;
+    }
+    const QString filePath = QFileInfo(m_databasePath).absoluteDir()
+                                 .filePath(QString("%1%2.db").arg(SHARD_FILE_PREFIX).arg(index));
+    m_shards.append({index, branch, filePath});
+
+    QSqlDatabase db = getShardDatabase(index);
+    if (!db.isOpen() || !initShardTables(db)) {
+        m_shards.removeLast();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    bool success = query.exec("CREATE TABLE IF NOT EXISTS shard_meta (key TEXT PRIMARY KEY, value TEXT)");
+    if (success) {
+        query.prepare("INSERT OR REPLACE INTO shard_meta (key, value) VALUES ('branch', ?)");
+        query.addBindValue(branch);
+        success = query.exec();
+    }
+    // 借阅ID从本分片号段起始，保证跨分片全局唯一（还书时可由ID直接定位分片）
+    if (success) {
+        query.prepare("INSERT INTO sqlite_sequence (name, seq) SELECT 'borrow', ? "
+                      "WHERE NOT EXISTS (SELECT 1 FROM sqlite_sequence WHERE name = 'borrow')");
+        query.addBindValue(index * SHARD_ID_SPAN);
+        success = query.exec();
+    }
+    if (!success) {
+        qCritical() << "初始化分馆分片失败：" << query.lastError().text();
+        m_shards.removeLast();
+        return false;
+    }
+    return true;
+}
+
+QString DatabaseManager::branchName(int shardIndex) const {
+    for (const ShardInfo& shard : m_shards) {
+        if (shard.index == shardIndex) {
+            return shard.branch;
+        }
+    }
+    return QString();
+}
+
+int DatabaseManager::shardOfBorrow(int borrowId) const {
+    const int index = borrowId / SHARD_ID_SPAN;
+    for (const ShardInfo& shard : m_shards) {
+        if (shard.index == index) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+int DatabaseManager::findBookShard(const QString& bookId) {
+    TRACE_SCOPE("db", "DatabaseManager::findBookShard");
+    // 本馆目录快照有效时直接在映射内存中二分查找，未命中也无需再查本馆库
+    const CatalogSnapshot* snapshot = catalogSnapshot();
+    if (snapshot && snapshot->findBook(bookId) >= 0) {
+        return m_currentShard;
+    }
+
+    // 优先查本馆，命中率最高
+    QVector<int> order;
+    if (!snapshot) {
+        order.append(m_currentShard);
+    }
+    for (const ShardInfo& shard : m_shards) {
+        if (shard.index != m_currentShard) {
+            order.append(shard.index);
+        }
+    }
+    for (int index : order) {
+        QSqlQuery query(getShardDatabase(index));
+        query.prepare("SELECT 1 FROM book WHERE book_id = ?");
+        query.addBindValue(bookId);
+        if (query.exec() && query.next()) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+int DatabaseManager::findReaderShard(const QString& readerId) {
+    TRACE_SCOPE("db", "DatabaseManager::findReaderShard");
+    const CatalogSnapshot* snapshot = catalogSnapshot();
+    if (snapshot && snapshot->findReader(readerId) >= 0) {
+        return m_currentShard;
+    }
+
+    QVector<int> order;
+    if (!snapshot) {
+        order.append(m_currentShard);
+    }
+    for (const ShardInfo& shard : m_shards) {
+        if (shard.index != m_currentShard) {
+            order.append(shard.index);
+        }
+    }
+    for (int index : order) {
+        QSqlQuery query(getShardDatabase(index));
+        query.prepare("SELECT 1 FROM reader WHERE reader_id = ?");
+        query.addBindValue(readerId);
+        if (query.exec() && query.next()) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+bool DatabaseManager::initTables() {
+    TRACE_SCOPE("db", "DatabaseManager::initTables");
+    if (!loadShards()) {
+        return false;
+    }
+
+    bool allSuccess = true;
+    for (const ShardInfo& shard : m_shards) {
+        QSqlDatabase db = getShardDatabase(shard.index);
+        if (!db.isOpen() || !initShardTables(db)) {
+            qCritical() << "初始化分片失败：" << shard.branch;
+            allSuccess = false;
+        }
+    }
+
+    // 确定本馆分片（不存在则新建）
+    m_currentShard = 0;
+    if (!m_currentBranchName.isEmpty() && m_currentBranchName != MAIN_BRANCH) {
+        auto it = std::find_if(m_shards.begin(), m_shards.end(), [this](const ShardInfo& shard) {
+            return shard.branch == m_currentBranchName;
+        });
+        if (it == m_shards.end()) {
+            if (!addBranch(m_currentBranchName)) {
+                return false;
+            }
+            m_currentShard = m_shards.last().index;
+        } else {
+            m_currentShard = it->index;
+        }
+    }
+
+    // 首次启用流通汇总时从历史借阅回填（失败不影响启动，报表缺少历史部分）
+    // 工作线程上在读快照中扫描，只在写回差额时短暂取写锁，界面和借还不等待
+    if (allSuccess) {
+        const QVector<ShardInfo> shards = m_shards;
+        m_rollupBackfill = QtConcurrent::run([shards]() {
+            TRACE_SCOPE("db", "DatabaseManager::rollupBackfillWorker");
+            for (const ShardInfo& shard : shards) {
+                CirculationRollup::backfillIfEmpty(shard);
+            }
+        });
+    }
+
+    // 映射本馆目录快照（缺失或过期时仍走数据库，不影响启动）
+    if (allSuccess) {
+        loadCatalogSnapshot();
+    }
+
+    return allSuccess;
+}
+
+void DatabaseManager::waitForRollupBackfill(bool cancel) {
+    if (cancel) {
+        CirculationRollup::cancelRebuild();
+    }
+    m_rollupBackfill.waitForFinished();
+}
+
+QString DatabaseManager::catalogSnapshotPath() const {
+    return shardFilePath(m_currentShard) + CATALOG_SNAPSHOT_SUFFIX;
+}
+
+bool DatabaseManager::loadCatalogSnapshot() {
+    TRACE_SCOPE("db", "DatabaseManager::loadCatalogSnapshot");
+    m_catalogStale = true;
+    m_catalogContentStale = true;
+    if (!m_catalogSnapshot.open(catalogSnapshotPath())) {
+        return false;
+    }
+    m_catalogDataVersion = dataVersion(m_currentShard);
+    bool idsChanged = true;
+    bool contentChanged = true;
+    catalogChangesSince(m_catalogSnapshot.changeSeq(), &idsChanged, &contentChanged);
+    if (idsChanged) {
+        m_catalogSnapshot.close();
+        return false;
+    }
+    m_catalogStale = false;
+    m_catalogContentStale = contentChanged;
+    return true;
+}
+
+bool DatabaseManager::saveCatalogSnapshot() {
+    // 后台生成尚未完成时等它写完再换入
+    if (m_catalogRebuildPending) {
+        m_catalogRebuild.waitForFinished();
+        installRebuiltCatalog();
+    }
+    updateCatalogState();
+    if (!m_catalogStale && !m_catalogContentStale) {
+        return true; // 快照与库中一致，无需重写
+    }
+    // 先解除映射再替换文件（Windows下已映射的文件不能被覆盖）
+    m_catalogSnapshot.close();
+    if (!CatalogSnapshot::build(shardFilePath(m_currentShard), catalogSnapshotPath())) {
+        return false;
+    }
+    return loadCatalogSnapshot();
+}
+
+const CatalogSnapshot* DatabaseManager::catalogSnapshot() {
+    installRebuiltCatalog();
+    updateCatalogState();
+    scheduleCatalogRebuild();
+    return m_catalogStale ? nullptr : &m_catalogSnapshot;
+}
+
+const CatalogSnapshot* DatabaseManager::currentCatalogSnapshot() {
+    const CatalogSnapshot* snapshot = catalogSnapshot();
+    return m_catalogContentStale ? nullptr : snapshot;
+}
+
+void DatabaseManager::updateCatalogState() {
+    if (m_catalogStale || !m_catalogSnapshot.isOpen()) {
+        m_catalogStale = true;
+        return;
+    }
+    // data_version未变说明没有任何新提交，无需查变更日志
+    const qint64 version = dataVersion(m_currentShard);
+    if (version == m_catalogDataVersion) {
+        return;
+    }
+    bool idsChanged = true;
+    bool contentChanged = true;
+    if (version >= 0) {
+        catalogChangesSince(m_catalogSnapshot.changeSeq(), &idsChanged, &contentChanged);
+    }
+    // 借还只改库存（'U'），编号集合不变，按编号查找继续可用；过期时仅做标记，映射保留到换入新快照时解除
+    m_catalogStale = idsChanged;
+    m_catalogContentStale = m_catalogContentStale || contentChanged;
+    m_catalogDataVersion = version;
+}
+
+void DatabaseManager::scheduleCatalogRebuild() {
+    if ((!m_catalogStale && !m_catalogContentStale) || m_catalogRebuildPending) {
+        return;
+    }
+    // 编号集合变化时尽快重建（期间查找退回逐库查询）；只有内容变化时按较长间隔重建（只影响首屏）
+    const int interval = m_catalogStale ? CATALOG_STALE_REBUILD_MS : CATALOG_REBUILD_INTERVAL_MS;
+    if (m_catalogBuildAge.isValid() && m_catalogBuildAge.elapsed() < interval) {
+        return;
+    }
+    m_catalogBuildAge.start();
+    m_catalogRebuildPending = true;
+    const QString dbFilePath = shardFilePath(m_currentShard);
+    const QString pendingPath = catalogSnapshotPath() + CATALOG_PENDING_SUFFIX;
+    m_catalogRebuild = QtConcurrent::run([dbFilePath, pendingPath]() {
+        return CatalogSnapshot::build(dbFilePath, pendingPath);
+    });
+}
+
+void DatabaseManager::installRebuiltCatalog() {
+    if (!m_catalogRebuildPending || !m_catalogRebuild.isFinished()) {
+        return;
+    }
+    // 首屏模型仍在读取旧映射时推迟换入
+    if (m_catalogSnapshot.isOpen() && m_catalogSnapshot.inUse()) {
+        return;
+    }
+    m_catalogRebuildPending = false;
+    const QString snapshotPath = catalogSnapshotPath();
+    const QString pendingPath = snapshotPath + CATALOG_PENDING_SUFFIX;
+    if (!m_catalogRebuild.result()) {
+        QFile::remove(pendingPath);
+        return;
+    }
+    // 先解除映射再替换文件（Windows下已映射的文件不能被覆盖）
+    m_catalogSnapshot.close();
+    QFile::remove(snapshotPath);
+    if (!QFile::rename(pendingPath, snapshotPath)) {
+        qWarning() << "替换目录快照失败：" << pendingPath;
+    }
+    loadCatalogSnapshot();
+}
+
+bool DatabaseManager::catalogChangesSince(qint64 changeSeq, bool* idsChanged, bool* contentChanged) {
+    // 日志已清理到快照序号之后、或数据库被替换为更旧的版本，无法得知改了什么，两者都视为已变化
+    QSqlQuery query(getReadDatabase(m_currentShard));
+    query.prepare(QString("SELECT EXISTS (SELECT 1 FROM change_log WHERE tbl IN ('%1', '%2') AND seq > ?), "
+                          "EXISTS (SELECT 1 FROM change_log WHERE tbl IN ('%1', '%2') AND seq > ? AND op IN ('I', 'D')) "
+                          "OR IFNULL((SELECT MIN(seq) FROM change_log), 0) > ? + 1 "
+                          "OR IFNULL((SELECT MAX(seq) FROM change_log), 0) < ?")
+                      .arg(BookTable::NAME, ReaderTable::NAME));
+    for (int i = 0; i < 4; ++i) {
+        query.addBindValue(changeSeq);
+    }
+    if (!query.exec() || !query.next()) {
+        qWarning() << "检查目录快照失败：" << query.lastError().text();
+        *idsChanged = true;
+        *contentChanged = true;
+        return false;
+    }
+    *idsChanged = query.value(1).toBool();
+    *contentChanged = *idsChanged || query.value(0).toBool();
+    return true;
+}
+
+bool DatabaseManager::initShardTables(QSqlDatabase& db) {
+    QSqlQuery query(db);
+    bool allSuccess = true;
+
+    // 1~3. 按表结构描述创建图书表、读者表、借阅表
+    const QString createSqls[] = {createTableSql<BookTable>(), createTableSql<ReaderTable>(),
+                                  createTableSql<BorrowTable>()};
+    for (const QString& createSql : createSqls) {
+        if (!query.exec(createSql)) {
+            qCritical() << "建表失败：" << query.lastError().text();
+            allSuccess = false;
+        }
+    }
+
+    // 4. 升级旧库结构（新增列等）
+    if (allSuccess && !migrateSchema(db)) {
+        allSuccess = false;
+    }
+
+    // 5. 应还时间索引（逾期查询走索引，避免全表扫描）
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_borrow_due_time ON borrow(due_time)")) {
+        qCritical() << "创建应还时间索引失败：" << query.lastError().text();
+        allSuccess = false;
+    }
+
+    // 6. 借书时间索引（导出按借书时间切分区间并有序扫描）
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_borrow_time ON borrow(borrow_time)")) {
+        qCritical() << "创建借书时间索引失败：" << query.lastError().text();
+        allSuccess = false;
+    }
+
+    // 7. 图书未还借阅索引（库存核对按图书统计未还借阅，只扫索引）
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_borrow_book ON borrow(book_id, return_time)")) {
+        qCritical() << "创建借阅图书索引失败：" << query.lastError().text();
+        allSuccess = false;
+    }
+
+    // 8. 变更日志及触发器（其他终端据此增量刷新界面）
+    QStringList changeSqls{createTableSql<ChangeLogTable>(),
+                           "CREATE INDEX IF NOT EXISTS idx_change_log_tbl ON change_log(tbl, seq)"};
+    changeSqls << changeTriggerSql<BookTable>() << changeTriggerSql<ReaderTable>()
+               << changeTriggerSql<BorrowTable>();
+    for (const QString& changeSql : changeSqls) {
+        if (!query.exec(changeSql)) {
+            qCritical() << "创建变更日志失败：" << query.lastError().text();
+            allSuccess = false;
+        }
+    }
+    if (allSuccess) {
+        pruneChangeLog(db);
+    }
+
+    // 9. 流通日汇总表及触发器（趋势报表合并日桶，不扫描借阅记录）
+    QStringList rollupSqls{createTableSql<CirculationDailyTable>()};
+    rollupSqls << rollupTriggerSql();
+    for (const QString& rollupSql : rollupSqls) {
+        if (!query.exec(rollupSql)) {
+            qCritical() << "创建流通汇总失败：" << query.lastError().text();
+            allSuccess = false;
+        }
+    }
+
+    // 10. 预约表、索引及变更日志触发器（预约队列据此同步其他终端的登记与取消）
+    QStringList reservationSqls{
+        createTableSql<ReservationTable>(),
+        "CREATE INDEX IF NOT EXISTS idx_reservation_book ON reservation(book_id, reader_id, status)",
+        "CREATE INDEX IF NOT EXISTS idx_reservation_hold ON reservation(hold_until) WHERE status = 'H'"};
+    reservationSqls << changeTriggerSql<ReservationTable>();
+    for (const QString& reservationSql : reservationSqls) {
+        if (!query.exec(reservationSql)) {
+            qCritical() << "创建预约表失败：" << query.lastError().text();
+            allSuccess = false;
+        }
+    }
+
+    // 11. 读者借阅/预约索引（删除读者时按读者查找关联记录，不扫全表）
+    const QString readerIndexSqls[] = {
+        "CREATE INDEX IF NOT EXISTS idx_borrow_reader ON borrow(reader_id, return_time)",
+        "CREATE INDEX IF NOT EXISTS idx_reservation_reader ON reservation(reader_id, status)"};
+    for (const QString& indexSql : readerIndexSqls) {
+        if (!query.exec(indexSql)) {
+            qCritical() << "创建读者索引失败：" << query.lastError().text();
+            allSuccess = false;
+        }
+    }
+
+    return allSuccess;
+}
+
+bool DatabaseManager::pruneChangeLog(QSqlDatabase& db) {
+    // seq为自增主键，按区间删除走主键索引
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM change_log WHERE seq <= (SELECT MAX(seq) FROM change_log) - ?");
+    query.addBindValue(CHANGE_LOG_RETAIN);
+    if (!query.exec()) {
+        qWarning() << "清理变更日志失败：" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+qint64 DatabaseManager::dataVersion(int shardIndex) {
+    QSqlQuery query(getReadDatabase(shardIndex));
+    if (!query.exec("PRAGMA data_version") || !query.next()) {
+        return -1;
+    }
+    return query.value(0).toLongLong();
+}
+
+qint64 DatabaseManager::latestChangeSeq(int shardIndex) {
+    QSqlQuery query(getReadDatabase(shardIndex));
+    if (!query.exec("SELECT IFNULL(MAX(seq), 0) FROM change_log") || !query.next()) {
+        qWarning() << "读取变更日志失败：" << query.lastError().text();
+        return -1;
+    }
+    return query.value(0).toLongLong();
+}
+
+bool DatabaseManager::readChanges(int shardIndex, const QString& table, qint64 afterSeq, int limit,
+                                  QVector<ChangeEntry>* entries, qint64* oldestSeq) {
+    TRACE_SCOPE("db", "DatabaseManager::readChanges");
+    QSqlDatabase db = getReadDatabase(shardIndex);
+    // 两条查询在同一读事务内，避免中途被其他终端清理导致判断不一致
+    if (!db.transaction()) {
+        qWarning() << "开启读事务失败：" << db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    bool success = query.exec("SELECT IFNULL(MIN(seq), 0) FROM change_log") && query.next();
+    if (success) {
+        *oldestSeq = query.value(0).toLongLong();
+        query.prepare("SELECT seq, row_key, op FROM change_log WHERE tbl = ? AND seq > ? ORDER BY seq LIMIT ?");
+        query.addBindValue(table);
+        query.addBindValue(afterSeq);
+        query.addBindValue(limit);
+        success = query.exec();
+    }
+    entries->clear();
+    while (success && query.next()) {
+        const QString op = query.value(2).toString();
+        entries->append({query.value(0).toLongLong(), query.value(1).toString(), op.isEmpty() ? QChar() : op.at(0)});
+    }
+    if (!success) {
+        qWarning() << "读取变更日志失败：" << query.lastError().text();
+    }
+    query.finish();
+    db.commit();
+    return success;
+}
+
+bool DatabaseManager::migrateSchema(QSqlDatabase& db) {
+    if (!db.transaction()) {
+        qCritical() << "开启升级事务失败：" << db.lastError().text();
+        return false;
+    }
+
+    // 旧库缺少的列按描述补齐（新增列的约束须满足ALTER TABLE ADD COLUMN的限制）
+    QStringList added;
+    bool success = addMissingColumns<BookTable>(db, &added)
+                   && addMissingColumns<ReaderTable>(db, &added)
+                   && addMissingColumns<BorrowTable>(db, &added);
+
+    // 图书表新增馆藏总数列时，按当前库存加未还借阅数回填
+    QSqlQuery query(db);
+    if (success && added.contains("book.total_copies")) {
+        if (!query.exec("UPDATE book SET total_copies = stock + (SELECT COUNT(*) FROM borrow "
+                        "WHERE borrow.book_id = book.book_id AND borrow.return_time IS NULL)")) {
+            qCritical() << "回填馆藏总数失败：" << query.lastError().text();
+            success = false;
+        }
+    }
+
+    // 借阅表新增应还时间列时，按默认借期回填旧记录
+    if (success && added.contains("borrow.due_time")) {
+        query.prepare("UPDATE borrow SET due_time = datetime(borrow_time, ?) WHERE due_time IS NULL");
+        query.addBindValue(QString("+%1 days").arg(LOAN_DAYS));
+        if (!query.exec()) {
+            qCritical() << "回填应还时间失败：" << query.lastError().text();
+            success = false;
+        }
+    }
+
+    if (!success) {
+        db.rollback();
+        return false;
+    }
+    if (!db.commit()) {
+        db.rollback();
+        qCritical() << "提交升级事务失败：" << db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+QSqlTableModel* DatabaseManager::getBookModel(QObject* parent, bool select) {
+    QSqlTableModel* model = new QSqlTableModel(parent, getDatabase());
+    model->setTable(BookTable::NAME);
+    model->setEditStrategy(QSqlTableModel::OnManualSubmit); // 手动提交（避免误操作）
+    if (select) {
+        selectModel(model);
+    }
+
+    // 设置友好列名
+    applyHeaderLabels<BookTable>(model);
+
+    return model;
+}
+
+QSqlTableModel* DatabaseManager::getReaderModel(QObject* parent) {
+    QSqlTableModel* model = new QSqlTableModel(parent, getDatabase());
+    model->setTable(ReaderTable::NAME);
+    model->setEditStrategy(QSqlTableModel::OnManualSubmit);
+    selectModel(model);
+
+    applyHeaderLabels<ReaderTable>(model);
+
+    return model;
+}
+
+QSqlTableModel* DatabaseManager::getBorrowModel(QObject* parent) {
+    // 借阅记录只经借还事务修改，视图绑定只读连接，不与写连接争用
+    QSqlTableModel* model = new QSqlTableModel(parent, getReadDatabase(m_currentShard));
+    model->setTable(BorrowTable::NAME);
+    model->setEditStrategy(QSqlTableModel::OnManualSubmit);
+    selectModel(model);
+
+    applyHeaderLabels<BorrowTable>(model);
+
+    return model;
+}
+
+bool DatabaseManager::isBusyError(const QSqlError& error) {
+    // SQLITE_BUSY(5)/SQLITE_LOCKED(6)：其他进程或连接持有写锁
+    const QString code = error.nativeErrorCode();
+    return code == "5" || code == "6" || error.databaseText().contains("is locked");
+}
+
+DatabaseManager::ContentionStats DatabaseManager::contentionStats() const {
+    ContentionStats stats;
+    stats.transactions = m_statTransactions.loadRelaxed();
+    stats.retries = m_statRetries.loadRelaxed();
+    stats.busyFailures = m_statBusyFailures.loadRelaxed();
+    stats.contentionMs = m_statContentionMs.loadRelaxed();
+    return stats;
+}
+
+bool DatabaseManager::runWithRetry(QSqlDatabase& db, const std::function<TxnStatus()>& attempt,
+                                   const char* operation) {
+    m_lastOperationBusy = false;
+    m_statTransactions.fetchAndAddRelaxed(1);
+
+    // 借还在界面线程上执行：每次尝试只在SQLite忙等待里停留一小段，其余等待交给事件循环里的退避，
+    // 最坏情况下界面也只停顿ATTEMPT_BUSY_TIMEOUT_MS，而不是忙等待超时乘以尝试次数
+    BusyTimeoutScope busyTimeout(db, m_busyTimeoutMs);
+
+    QElapsedTimer contention;
+    bool contended = false;
+    for (int attemptNo = 1; ; ++attemptNo) {
+        TxnStatus status;
+        {
+            TRACE_SCOPE("db", "DatabaseManager::transactionAttempt");
+            busyTimeout.set(ATTEMPT_BUSY_TIMEOUT_MS); // 等待期间触发的其他操作可能已恢复原值，每次尝试前重设
+            status = attempt();
+        }
+        if (status != TxnStatus::Busy) {
+            if (contended) {
+                m_statContentionMs.fetchAndAddRelaxed(contention.elapsed());
+            }
+            return status == TxnStatus::Committed;
+        }
+
+        if (!contended) {
+            contended = true;
+            contention.start();
+        }
+        if (attemptNo >= m_retryPolicy.maxAttempts) {
+            m_statContentionMs.fetchAndAddRelaxed(contention.elapsed());
+            m_statBusyFailures.fetchAndAddRelaxed(1);
+            m_lastOperationBusy = true;
+            qCritical() << operation << "：数据库繁忙，已重试" << attemptNo << "次";
+            return false;
+        }
+
+        // 指数退避+全抖动：在[0, min(上限, 基数*2^n)]内随机等待，错开竞争进程的重试时刻
+        const int ceiling = int(std::min<qint64>(m_retryPolicy.maxDelayMs,
+                                                 qint64(m_retryPolicy.baseDelayMs) << (attemptNo - 1)));
+        const int delayMs = int(QRandomGenerator::global()->bounded(ceiling + 1));
+        m_statRetries.fetchAndAddRelaxed(1);
+        waitInEventLoop(delayMs);
+    }
+}
+
+bool DatabaseManager::borrowBook(const QString& bookId, const QString& readerId) {
+    TRACE_SCOPE("db", "DatabaseManager::borrowBook");
+    m_lastBorrowOutOfStock = false;
+    // 借阅记录写入图书所属分片
+    const int shard = findBookShard(bookId);
+    if (shard < 0) {
+        qCritical() << "图书不存在：" << bookId;
+        return false;
+    }
+    QSqlDatabase db = getShardDatabase(shard);
+    if (!db.isOpen()) {
+        return false;
+    }
+
+    int borrowId = 0;
+    qint64 dueSecs = 0;
+    QVector<int> fulfilled;
+    bool fromHold = false;
+    if (!runWithRetry(db, [&]() {
+            return tryBorrowBook(db, bookId, readerId, &borrowId, &dueSecs, &fulfilled, &fromHold);
+        }, "借书")) {
+        return false;
+    }
+
+    // 提交成功后登记到期时间、移出已取书的预约并记入审计日志
+    OverdueScheduler::getInstance().schedule(borrowId, dueSecs);
+    for (int reservationId : fulfilled) {
+        HoldQueue::getInstance().remove(shard, reservationId);
+        auditReservation(shard, reservationId, bookId, readerId, QString("status -> F（借阅ID %1）").arg(borrowId));
+    }
+
+    AuditEvent event;
+    event.action = AuditEvent::Borrow;
+    event.table = BorrowTable::NAME;
+    event.branch = branchName(shard);
+    event.rowKey = QString::number(borrowId);
+    event.bookId = bookId;
+    event.readerId = readerId;
+    event.detail = QString("应还时间: %1").arg(QDateTime::fromSecsSinceEpoch(dueSecs).toString("yyyy-MM-dd HH:mm:ss"));
+    if (fromHold) {
+        event.detail += "（预约取书）";
+    }
+    AuditLog::getInstance().record(std::move(event));
+    return true;
+}
+
+DatabaseManager::TxnStatus DatabaseManager::tryBorrowBook(QSqlDatabase& db, const QString& bookId,
+                                                          const QString& readerId, int* borrowId, qint64* dueSecs,
+                                                          QVector<int>* fulfilled, bool* fromHold) {
+    QSqlQuery query(db);
+
+    // 开启事务（IMMEDIATE：开始即取得写锁，避免读锁升级为写锁时与其他进程互相等待）
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        if (isBusyError(query.lastError())) {
+            return TxnStatus::Busy;
+        }
+        qCritical() << "开启借书事务失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+
+    // 1. 该读者对此书的有效预约：已留书时取走留出的副本，等待中的随本次借阅一并结束
+    fulfilled->clear();
+    *fromHold = false;
+    query.prepare("SELECT id, status FROM reservation WHERE book_id = ? AND reader_id = ? AND status IN ('W', 'H')");
+    query.addBindValue(bookId);
+    query.addBindValue(readerId);
+    if (!query.exec()) {
+        db.rollback();
+        qCritical() << "查询预约失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    QVector<int> reservations;
+    while (query.next()) {
+        reservations.append(query.value(0).toInt());
+        if (query.value(1).toString() == "H") {
+            *fromHold = true;
+        }
+    }
+
+    // 2. 校验图书存在且库存>0（留出的副本不计入库存，无需校验）
+    query.prepare("SELECT stock FROM book WHERE book_id = ?");
+    query.addBindValue(bookId);
+    if (!query.exec() || !query.next()) {
+        db.rollback();
+        qCritical() << "校验图书失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    int stock = query.value(0).toInt();
+    if (stock <= 0 && !*fromHold) {
+        db.rollback();
+        m_lastBorrowOutOfStock = true;
+        qWarning() << "图书库存不足：" << bookId;
+        return TxnStatus::Failed;
+    }
+
+    // 3. 校验读者存在（读者可登记在任一分馆）
+    query.prepare("SELECT 1 FROM reader WHERE reader_id = ?");
+    query.addBindValue(readerId);
+    if ((!query.exec() || !query.next()) && findReaderShard(readerId) < 0) {
+        db.rollback();
+        qCritical() << "读者不存在：" << readerId;
+        return TxnStatus::Failed;
+    }
+
+    // 4. 插入借阅记录（应还时间 = 当前时间 + 默认借期）
+    query.prepare("INSERT INTO borrow (book_id, reader_id, due_time) VALUES (?, ?, datetime('now', ?))");
+    query.addBindValue(bookId);
+    query.addBindValue(readerId);
+    query.addBindValue(QString("+%1 days").arg(LOAN_DAYS));
+    if (!query.exec()) {
+        db.rollback();
+        qCritical() << "插入借阅记录失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    *borrowId = query.lastInsertId().toInt();
+
+    query.prepare("SELECT strftime('%s', due_time) FROM borrow WHERE id = ?");
+    query.addBindValue(*borrowId);
+    if (!query.exec() || !query.next()) {
+        db.rollback();
+        qCritical() << "读取应还时间失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    *dueSecs = query.value(0).toLongLong();
+
+    // 5. 扣减图书库存（取走留出的副本时库存已在留书时扣除）
+    if (!*fromHold) {
+        query.prepare("UPDATE book SET stock = stock - 1 WHERE book_id = ?");
+        query.addBindValue(bookId);
+        if (!query.exec()) {
+            db.rollback();
+            qCritical() << "更新库存失败：" << query.lastError().text();
+            return TxnStatus::Failed;
+        }
+    }
+
+    // 6. 结束该读者对此书的预约
+    if (!reservations.isEmpty()) {
+        query.prepare("UPDATE reservation SET status = 'F' "
+                      "WHERE book_id = ? AND reader_id = ? AND status IN ('W', 'H')");
+        query.addBindValue(bookId);
+        query.addBindValue(readerId);
+        if (!query.exec()) {
+            db.rollback();
+            qCritical() << "更新预约状态失败：" << query.lastError().text();
+            return TxnStatus::Failed;
+        }
+    }
+
+    // 提交事务
+    if (!db.commit()) {
+        const bool busy = isBusyError(db.lastError());
+        db.rollback();
+        if (busy) {
+            return TxnStatus::Busy;
+        }
+        qCritical() << "提交借书事务失败：" << db.lastError().text();
+        return TxnStatus::Failed;
+    }
 
-    return db;
+    *fulfilled = reservations;
+    return TxnStatus::Committed;
 }
 
-bool DatabaseManager::initTables() {
-    QSqlDatabase db = getDatabase();
+bool DatabaseManager::returnBook(int borrowId, HoldAssignment* hold) {
+    TRACE_SCOPE("db", "DatabaseManager::returnBook");
+    // 借阅ID号段即所属分片
+    const int shard = shardOfBorrow(borrowId);
+    if (shard < 0) {
+        qCritical() << "借阅记录无效/已归还：" << borrowId;
+        return false;
+    }
+    QSqlDatabase db = getShardDatabase(shard);
     if (!db.isOpen()) {
         return false;
     }
 
-    QSqlQuery query(db);
-    bool allSuccess = true;
-
-    // 1. 创建图书表（含主键+外键约束）
-    const QString createBookSql = R"(
-        CREATE TABLE IF NOT EXISTS book (
-            book_id VARCHAR(20) PRIMARY KEY NOT NULL,
-            book_name VARCHAR(100) NOT NULL,
-            author VARCHAR(50) NOT NULL,
-            category VARCHAR(30),
-            stock INTEGER NOT NULL DEFAULT 0 CHECK(stock >= 0)
-        )
-    )";
-    if (!query.exec(createBookSql)) {
-        qCritical() << "创建图书表失败：" << query.lastError().text();
-        allSuccess = false;
+    QString bookId;
+    QString readerId;
+    bool overdue = false;
+    HoldAssignment assignment;
+    if (!runWithRetry(db, [&]() {
+            return tryReturnBook(db, shard, borrowId, &bookId, &readerId, &overdue, &assignment);
+        }, "还书")) {
+        return false;
     }
 
-    // 2. 创建读者表
-    const QString createReaderSql = R"(
-        CREATE TABLE IF NOT EXISTS reader (
-            reader_id VARCHAR(20) PRIMARY KEY NOT NULL,
-            reader_name VARCHAR(50) NOT NULL,
-            phone VARCHAR(20)
-        )
-    )";
-    if (!query.exec(createReaderSql)) {
-        qCritical() << "创建读者表失败：" << query.lastError().text();
-        allSuccess = false;
-    }
+    OverdueScheduler::getInstance().cancel(borrowId);
 
-    // 3. 创建借阅表（含外键关联）
-    const QString createBorrowSql = R"(
-        CREATE TABLE IF NOT EXISTS borrow (
-            id INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,
-            book_id VARCHAR(20) NOT NULL,
-            reader_id VARCHAR(20) NOT NULL,
-            borrow_time DATETIME DEFAULT CURRENT_TIMESTAMP,
-            return_time DATETIME,
-            FOREIGN KEY(book_id) REFERENCES book(book_id) ON DELETE CASCADE,
-            FOREIGN KEY(reader_id) REFERENCES reader(reader_id) ON DELETE CASCADE
-        )
-    )";
-    if (!query.exec(createBorrowSql)) {
-        qCritical() << "创建借阅表失败：" << query.lastError().text();
-        allSuccess = false;
+    AuditEvent event;
+    event.action = AuditEvent::Return;
+    event.table = BorrowTable::NAME;
+    event.branch = branchName(shard);
+    event.rowKey = QString::number(borrowId);
+    event.bookId = bookId;
+    event.readerId = readerId;
+    if (overdue) {
+        event.detail = "逾期归还";
     }
+    AuditLog::getInstance().record(std::move(event));
 
-    return allSuccess;
+    // 副本已留给预约读者：出队并记入审计日志
+    if (assignment.reservationId > 0) {
+        HoldQueue::getInstance().remove(shard, assignment.reservationId);
+        auditReservation(shard, assignment.reservationId, bookId, assignment.readerId,
+                         QString("status: W -> H（借阅ID %1 归还的副本）").arg(borrowId));
+    }
+    if (hold) {
+        *hold = assignment;
+    }
+    return true;
 }
 
-QSqlTableModel* DatabaseManager::getBookModel(QObject* parent) {
-    QSqlTableModel* model = new QSqlTableModel(parent, getDatabase());
-    model->setTable("book");
-    model->setEditStrategy(QSqlTableModel::OnManualSubmit); // 手动提交（避免误操作）
-    model->select();
+DatabaseManager::TxnStatus DatabaseManager::tryReturnBook(QSqlDatabase& db, int shardIndex, int borrowId,
+                                                          QString* bookId, QString* readerId, bool* overdue,
+                                                          HoldAssignment* hold) {
+    QSqlQuery query(db);
 
-    // 设置友好列名
-    model->setHeaderData(0, Qt::Horizontal, "图书编号");
-    model->setHeaderData(1, Qt::Horizontal, "图书名称");
-    model->setHeaderData(2, Qt::Horizontal, "作者");
-    model->setHeaderData(3, Qt::Horizontal, "分类");
-    model->setHeaderData(4, Qt::Horizontal, "库存");
+    // 开启事务
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        if (isBusyError(query.lastError())) {
+            return TxnStatus::Busy;
+        }
+        qCritical() << "开启还书事务失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
 
-    return model;
-}
+    // 1. 校验借阅记录存在且未归还
+    query.prepare("SELECT book_id, reader_id FROM borrow WHERE id = ? AND return_time IS NULL");
+    query.addBindValue(borrowId);
+    if (!query.exec() || !query.next()) {
+        db.rollback();
+        qCritical() << "借阅记录无效/已归还：" << borrowId;
+        return TxnStatus::Failed;
+    }
+    *bookId = query.value(0).toString();
+    *readerId = query.value(1).toString();
 
-QSqlTableModel* DatabaseManager::getReaderModel(QObject* parent) {
-    QSqlTableModel* model = new QSqlTableModel(parent, getDatabase());
-    model->setTable("reader");
-    model->setEditStrategy(QSqlTableModel::OnManualSubmit);
-    model->select();
+    // 2. 更新还书时间
+    query.prepare("UPDATE borrow SET return_time = CURRENT_TIMESTAMP WHERE id = ?");
+    query.addBindValue(borrowId);
+    if (!query.exec()) {
+        db.rollback();
+        qCritical() << "更新还书时间失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
 
-    model->setHeaderData(0, Qt::Horizontal, "读者编号");
-    model->setHeaderData(1, Qt::Horizontal, "读者姓名");
-    model->setHeaderData(2, Qt::Horizontal, "联系方式");
+    // 按刚写入的还书时间判断是否逾期（借出终端的逾期事件不一定在本进程）
+    query.prepare("SELECT due_time < return_time FROM borrow WHERE id = ?");
+    query.addBindValue(borrowId);
+    if (!query.exec() || !query.next()) {
+        db.rollback();
+        qCritical() << "读取应还时间失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    *overdue = query.value(0).toBool();
 
-    return model;
+    // 3. 副本留给预约队首读者，无人等待时恢复图书库存
+    if (!allocateCopy(db, shardIndex, *bookId, hold)) {
+        db.rollback();
+        return TxnStatus::Failed;
+    }
+
+    // 提交事务
+    if (!db.commit()) {
+        const bool busy = isBusyError(db.lastError());
+        db.rollback();
+        if (busy) {
+            return TxnStatus::Busy;
+        }
+        qCritical() << "提交还书事务失败：" << db.lastError().text();
+        return TxnStatus::Failed;
+    }
+
+    return TxnStatus::Committed;
 }
 
-QSqlTableModel* DatabaseManager::getBorrowModel(QObject* parent) {
-    QSqlTableModel* model = new QSqlTableModel(parent, getDatabase());
-    model->setTable("borrow");
-    model->setEditStrategy(QSqlTableModel::OnManualSubmit);
-    model->select();
+bool DatabaseManager::allocateCopy(QSqlDatabase& db, int shardIndex, const QString& bookId, HoldAssignment* hold) {
+    TRACE_SCOPE("db", "DatabaseManager::allocateCopy");
+    *hold = HoldAssignment();
+    QSqlQuery query(db);
 
-    model->setHeaderData(0, Qt::Horizontal, "借阅ID");
-    model->setHeaderData(1, Qt::Horizontal, "图书编号");
-    model->setHeaderData(2, Qt::Horizontal, "读者编号");
-    model->setHeaderData(3, Qt::Horizontal, "借书时间");
-    model->setHeaderData(4, Qt::Horizontal, "还书时间");
+    // 队首按主键更新：内存队列在写锁内同步过，仍不一致（已被取走或取消）的项直接剔除再取下一位
+    HoldQueue& holds = HoldQueue::getInstance();
+    HoldQueue::Waiter waiter;
+    while (holds.peek(shardIndex, bookId, &waiter)) {
+        query.prepare("UPDATE reservation SET status = 'H', hold_until = datetime('now', ?) "
+                      "WHERE id = ? AND status = 'W'");
+        query.addBindValue(QString("+%1 days").arg(HOLD_DAYS));
+        query.addBindValue(waiter.reservationId);
+        if (!query.exec()) {
+            qCritical() << "留书失败：" << query.lastError().text();
+            return false;
+        }
+        if (query.numRowsAffected() == 1) {
+            hold->reservationId = waiter.reservationId;
+            hold->readerId = waiter.readerId;
+            return true;
+        }
+        holds.remove(shardIndex, waiter.reservationId);
+    }
 
-    return model;
+    query.prepare("UPDATE book SET stock = stock + 1 WHERE book_id = ?");
+    query.addBindValue(bookId);
+    if (!query.exec()) {
+        qCritical() << "恢复库存失败：" << query.lastError().text();
+        return false;
+    }
+    return true;
 }
 
-bool DatabaseManager::borrowBook(const QString& bookId, const QString& readerId) {
-    QSqlDatabase db = getDatabase();
+bool DatabaseManager::reserveBook(const QString& bookId, const QString& readerId, int* waitingCount) {
+    TRACE_SCOPE("db", "DatabaseManager::reserveBook");
+    // 预约登记在图书所属分片，与借还记录同库，留书可在还书事务内完成
+    const int shard = findBookShard(bookId);
+    if (shard < 0) {
+        qCritical() << "图书不存在：" << bookId;
+        return false;
+    }
+    const int readerShard = findReaderShard(readerId);
+    if (readerShard < 0) {
+        qCritical() << "读者不存在：" << readerId;
+        return false;
+    }
+    QSqlDatabase db = getShardDatabase(shard);
     if (!db.isOpen()) {
         return false;
     }
 
-    // 开启事务（保证原子性：要么全成功，要么全回滚）
-    if (!db.transaction()) {
-        qCritical() << "开启借书事务失败：" << db.lastError().text();
+    // 优先级取登记时读者的设置（读者可登记在其他分馆）
+    int priority = 0;
+    QSqlQuery query(getReadDatabase(readerShard));
+    query.prepare("SELECT priority FROM reader WHERE reader_id = ?");
+    query.addBindValue(readerId);
+    if (query.exec() && query.next()) {
+        priority = query.value(0).toInt();
+    }
+    query.finish();
+
+    int reservationId = 0;
+    if (!runWithRetry(db, [&]() { return tryReserveBook(db, bookId, readerId, priority, &reservationId); }, "预约")) {
         return false;
     }
 
+    HoldQueue& holds = HoldQueue::getInstance();
+    holds.add(shard, bookId, {reservationId, priority, readerId});
+    if (waitingCount) {
+        *waitingCount = holds.waitingCount(shard, bookId);
+    }
+
+    AuditEvent event;
+    event.action = AuditEvent::Insert;
+    event.table = ReservationTable::NAME;
+    event.branch = branchName(shard);
+    event.rowKey = QString::number(reservationId);
+    event.bookId = bookId;
+    event.readerId = readerId;
+    event.detail = QString("priority: %1").arg(priority);
+    AuditLog::getInstance().record(std::move(event));
+    return true;
+}
+
+DatabaseManager::TxnStatus DatabaseManager::tryReserveBook(QSqlDatabase& db, const QString& bookId,
+                                                           const QString& readerId, int priority,
+                                                           int* reservationId) {
     QSqlQuery query(db);
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        if (isBusyError(query.lastError())) {
+            return TxnStatus::Busy;
+        }
+        qCritical() << "开启预约事务失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
 
-    // 1. 校验图书存在且库存>0
+    // 1. 校验图书存在且已无库存（有库存时直接借阅）
     query.prepare("SELECT stock FROM book WHERE book_id = ?");
     query.addBindValue(bookId);
     if (!query.exec() || !query.next()) {
         db.rollback();
         qCritical() << "校验图书失败：" << query.lastError().text();
-        return false;
+        return TxnStatus::Failed;
     }
-    int stock = query.value(0).toInt();
-    if (stock <= 0) {
+    if (query.value(0).toInt() > 0) {
         db.rollback();
-        qWarning() << "图书库存不足：" << bookId;
-        return false;
+        qWarning() << "图书尚有库存，无需预约：" << bookId;
+        return TxnStatus::Failed;
     }
 
-    // 2. 校验读者存在
-    query.prepare("SELECT 1 FROM reader WHERE reader_id = ?");
+    // 2. 同一读者对同一本书只保留一条有效预约
+    query.prepare("SELECT 1 FROM reservation WHERE book_id = ? AND reader_id = ? AND status IN ('W', 'H')");
+    query.addBindValue(bookId);
     query.addBindValue(readerId);
-    if (!query.exec() || !query.next()) {
+    if (!query.exec()) {
         db.rollback();
-        qCritical() << "读者不存在：" << readerId;
-        return false;
+        qCritical() << "查询预约失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    if (query.next()) {
+        db.rollback();
+        qWarning() << "读者已预约该书：" << readerId << bookId;
+        return TxnStatus::Failed;
     }
 
-    // 3. 插入借阅记录
-    query.prepare("INSERT INTO borrow (book_id, reader_id) VALUES (?, ?)");
+    // 3. 插入预约记录
+    query.prepare("INSERT INTO reservation (book_id, reader_id, priority) VALUES (?, ?, ?)");
     query.addBindValue(bookId);
     query.addBindValue(readerId);
+    query.addBindValue(priority);
     if (!query.exec()) {
         db.rollback();
-        qCritical() << "插入借阅记录失败：" << query.lastError().text();
+        qCritical() << "插入预约记录失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    *reservationId = query.lastInsertId().toInt();
+
+    if (!db.commit()) {
+        const bool busy = isBusyError(db.lastError());
+        db.rollback();
+        if (busy) {
+            return TxnStatus::Busy;
+        }
+        qCritical() << "提交预约事务失败：" << db.lastError().text();
+        return TxnStatus::Failed;
+    }
+    return TxnStatus::Committed;
+}
+
+bool DatabaseManager::cancelReservation(int shardIndex, int reservationId) {
+    TRACE_SCOPE("db", "DatabaseManager::cancelReservation");
+    return closeReservation(shardIndex, reservationId, QLatin1Char('C'));
+}
+
+int DatabaseManager::expireHolds() {
+    TRACE_SCOPE("db", "DatabaseManager::expireHolds");
+    int expired = 0;
+    for (const ShardInfo& shard : m_shards) {
+        // 只扫部分索引中已到期的留书
+        QVector<int> due;
+        {
+            QSqlQuery query(getReadDatabase(shard.index));
+            query.setForwardOnly(true);
+            if (!query.exec("SELECT id FROM reservation WHERE status = 'H' AND hold_until <= datetime('now')")) {
+                qWarning() << "查询过期留书失败：" << shard.branch << query.lastError().text();
+                continue;
+            }
+            while (query.next()) {
+                due.append(query.value(0).toInt());
+            }
+        }
+        for (int reservationId : due) {
+            if (closeReservation(shard.index, reservationId, QLatin1Char('X'))) {
+                ++expired;
+            }
+        }
+    }
+    return expired;
+}
+
+bool DatabaseManager::closeReservation(int shardIndex, int reservationId, QChar status) {
+    QSqlDatabase db = getShardDatabase(shardIndex);
+    if (!db.isOpen()) {
         return false;
     }
 
-    // 4. 扣减图书库存
-    query.prepare("UPDATE book SET stock = stock - 1 WHERE book_id = ?");
-    query.addBindValue(bookId);
+    QString bookId;
+    QString readerId;
+    QChar oldStatus;
+    HoldAssignment next;
+    if (!runWithRetry(db, [&]() {
+            return tryCloseReservation(db, shardIndex, reservationId, status, &bookId, &readerId, &oldStatus, &next);
+        }, status == QLatin1Char('X') ? "留书过期" : "取消预约")) {
+        return false;
+    }
+
+    HoldQueue& holds = HoldQueue::getInstance();
+    holds.remove(shardIndex, reservationId);
+    auditReservation(shardIndex, reservationId, bookId, readerId,
+                     QString("status: %1 -> %2").arg(oldStatus).arg(status));
+    if (next.reservationId > 0) {
+        holds.remove(shardIndex, next.reservationId);
+        auditReservation(shardIndex, next.reservationId, bookId, next.readerId,
+                         QString("status: W -> H（预约ID %1 释放的副本）").arg(reservationId));
+    }
+    return true;
+}
+
+DatabaseManager::TxnStatus DatabaseManager::tryCloseReservation(QSqlDatabase& db, int shardIndex, int reservationId,
+                                                                QChar status, QString* bookId, QString* readerId,
+                                                                QChar* oldStatus, HoldAssignment* next) {
+    QSqlQuery query(db);
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        if (isBusyError(query.lastError())) {
+            return TxnStatus::Busy;
+        }
+        qCritical() << "开启预约事务失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+
+    // 1. 校验预约仍有效（过期只处理已到期的留书：定时清理读到之后读者可能已取书）
+    query.prepare("SELECT book_id, reader_id, status FROM reservation WHERE id = ? AND status IN ('W', 'H') "
+                  "AND (? = 'C' OR (status = 'H' AND hold_until <= datetime('now')))");
+    query.addBindValue(reservationId);
+    query.addBindValue(QString(status));
+    if (!query.exec() || !query.next()) {
+        db.rollback();
+        qWarning() << "预约不存在或已结束：" << reservationId << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    *bookId = query.value(0).toString();
+    *readerId = query.value(1).toString();
+    *oldStatus = query.value(2).toString().at(0);
+
+    // 2. 更新预约状态
+    query.prepare("UPDATE reservation SET status = ? WHERE id = ?");
+    query.addBindValue(QString(status));
+    query.addBindValue(reservationId);
     if (!query.exec()) {
         db.rollback();
-        qCritical() << "更新库存失败：" << query.lastError().text();
-        return false;
+        qCritical() << "更新预约状态失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+
+    // 3. 已留出的副本转给下一位或回库
+    *next = HoldAssignment();
+    if (*oldStatus == QLatin1Char('H') && !allocateCopy(db, shardIndex, *bookId, next)) {
+        db.rollback();
+        return TxnStatus::Failed;
     }
 
-    // 提交事务
     if (!db.commit()) {
+        const bool busy = isBusyError(db.lastError());
         db.rollback();
-        qCritical() << "提交借书事务失败：" << db.lastError().text();
-        return false;
+        if (busy) {
+            return TxnStatus::Busy;
+        }
+        qCritical() << "提交预约事务失败：" << db.lastError().text();
+        return TxnStatus::Failed;
     }
+    return TxnStatus::Committed;
+}
 
-    return true;
+void DatabaseManager::auditReservation(int shardIndex, int reservationId, const QString& bookId,
+                                       const QString& readerId, const QString& detail) {
+    AuditEvent event;
+    event.action = AuditEvent::Update;
+    event.table = ReservationTable::NAME;
+    event.branch = branchName(shardIndex);
+    event.rowKey = QString::number(reservationId);
+    event.bookId = bookId;
+    event.readerId = readerId;
+    event.detail = detail;
+    AuditLog::getInstance().record(std::move(event));
+}
+
+QStandardItemModel* DatabaseManager::getReservationModel(QObject* parent) {
+    QStandardItemModel* model = new QStandardItemModel(parent);
+    refreshReservationModel(model);
+    return model;
+}
+
+bool DatabaseManager::refreshReservationModel(QStandardItemModel* model) {
+    TRACE_SCOPE("model", "DatabaseManager::refreshReservationModel");
+    // 只列有效预约（条数少）：逐个分片经只读连接一次取完，及时释放读游标
+    struct ReservationRow {
+        QString bookId;
+        QList<QStandardItem*> items;
+    };
+    const QString sql = QString("SELECT %1 FROM reservation r LEFT JOIN book b ON b.book_id = r.book_id "
+                                "WHERE r.status IN ('W', 'H') ORDER BY %2")
+                            .arg(selectListSql<ReservationQueueView>(), QLatin1String(ReservationQueueView::ORDER_BY));
+    const bool multiBranch = m_shards.size() > 1;
+    QVector<QVector<ReservationRow>> parts;
+    bool allOk = true;
+    for (const ShardInfo& shard : m_shards) {
+        QVector<ReservationRow> rows;
+        QSqlQuery query(getReadDatabase(shard.index));
+        query.setForwardOnly(true);
+        if (!query.exec(sql)) {
+            qWarning() << "查询预约队列失败：" << shard.branch << query.lastError().text();
+            allOk = false;
+            continue;
+        }
+        while (query.next()) {
+            ReservationRow row;
+            row.bookId = query.value(ReservationQueueView::BookId).toString();
+            for (int i = 0; i < ReservationQueueView::ColumnCount; ++i) {
+                row.items.append(new QStandardItem(query.value(i).toString()));
+            }
+            if (multiBranch) {
+                row.items.append(new QStandardItem(shard.branch));
+            }
+            row.items.first()->setData(shard.index, Qt::UserRole);
+            for (QStandardItem* item : row.items) {
+                item->setEditable(false);
+            }
+            rows.append(row);
+        }
+        parts.append(rows);
+    }
+
+    // 图书只属于一个分片：各分片已按图书排好，按图书编号归并后同一图书的队列顺序不变
+    const QVector<ReservationRow> rows = mergeSortedParts(parts, [](const ReservationRow& a, const ReservationRow& b) {
+        return a.bookId < b.bookId;
+    });
+    QStringList labels;
+    for (const SelectColumnDef& column : ReservationQueueView::COLUMNS) {
+        labels << QString::fromUtf8(column.label);
+    }
+    if (multiBranch) {
+        labels << "所属分馆";
+    }
+    model->clear();
+    model->setHorizontalHeaderLabels(labels);
+    for (const ReservationRow& row : rows) {
+        model->appendRow(row.items);
+    }
+    return allOk;
 }
 
-bool DatabaseManager::returnBook(int borrowId) {
-    QSqlDatabase db = getDatabase();
+DatabaseManager::BulkDeleteResult DatabaseManager::deleteBooks(const QStringList& bookIds,
+                                                               const BulkProgress& progress) {
+    TRACE_SCOPE("db", "DatabaseManager::deleteBooks");
+    return bulkDelete(BookTable::NAME, BookTable::COLUMNS[BookTable::BookId].name, bookIds, progress);
+}
+
+DatabaseManager::BulkDeleteResult DatabaseManager::deleteReaders(const QStringList& readerIds,
+                                                                 const BulkProgress& progress) {
+    TRACE_SCOPE("db", "DatabaseManager::deleteReaders");
+    return bulkDelete(ReaderTable::NAME, ReaderTable::COLUMNS[ReaderTable::ReaderId].name, readerIds, progress);
+}
+
+DatabaseManager::BulkDeleteResult DatabaseManager::bulkDelete(const QString& table, const QString& keyColumn,
+                                                              const QStringList& keys, const BulkProgress& progress) {
+    BulkDeleteResult result;
+    QSqlDatabase db = getShardDatabase(m_currentShard);
     if (!db.isOpen()) {
-        return false;
+        result.ok = false;
+        return result;
     }
 
-    // 开启事务
-    if (!db.transaction()) {
-        qCritical() << "开启还书事务失败：" << db.lastError().text();
-        return false;
+    // 分块提交：单个事务只持有写锁几毫秒，其他终端的借还可在块之间穿插
+    const int total = keys.size();
+    for (int offset = 0; offset < total; offset += BULK_DELETE_CHUNK) {
+        QStringList chunk = keys.mid(offset, BULK_DELETE_CHUNK);
+
+        // 删除事务只锁本馆分片：其他分片上仍有未还借阅或留书的读者先行排除，计入跳过
+        if (table == ReaderTable::NAME) {
+            QStringList active;
+            if (!readersActiveElsewhere(chunk, &active)) {
+                result.ok = false;
+                break;
+            }
+            for (const QString& readerId : active) {
+                chunk.removeAll(readerId);
+            }
+            result.skipped += active.size();
+        }
+
+        QVector<DeletedRow> deleted;
+        int skipped = 0;
+        QVector<int> waiting;
+        if (!chunk.isEmpty()
+            && !runWithRetry(db, [&]() { return tryDeleteChunk(db, table, keyColumn, chunk, &deleted, &skipped, &waiting); },
+                             "批量删除")) {
+            result.ok = false;
+            break;
+        }
+        result.deleted += deleted.size();
+        result.skipped += skipped;
+
+        // 提交成功后移出随之删除的等待中预约，并逐条记入审计日志
+        for (int reservationId : waiting) {
+            HoldQueue::getInstance().remove(m_currentShard, reservationId);
+        }
+        for (const DeletedRow& row : deleted) {
+            AuditEvent event;
+            event.action = AuditEvent::Delete;
+            event.table = table;
+            event.branch = branchName(m_currentShard);
+            event.rowKey = row.key;
+            if (table == BookTable::NAME) {
+                event.bookId = row.key;
+            } else {
+                event.readerId = row.key;
+            }
+            event.detail = row.detail;
+            AuditLog::getInstance().record(std::move(event));
+        }
+
+        if (progress && !progress(std::min(offset + BULK_DELETE_CHUNK, total), total)) {
+            break;
+        }
     }
+    return result;
+}
 
+DatabaseManager::TxnStatus DatabaseManager::tryDeleteChunk(QSqlDatabase& db, const QString& table,
+                                                           const QString& keyColumn, const QStringList& keys,
+                                                           QVector<DeletedRow>* deleted, int* skipped,
+                                                           QVector<int>* waiting) {
     QSqlQuery query(db);
+    deleted->clear();
+    *skipped = 0;
+    waiting->clear();
 
-    // 1. 校验借阅记录存在且未归还
-    query.prepare("SELECT book_id FROM borrow WHERE id = ? AND return_time IS NULL");
-    query.addBindValue(borrowId);
-    if (!query.exec() || !query.next()) {
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        if (isBusyError(query.lastError())) {
+            return TxnStatus::Busy;
+        }
+        qCritical() << "开启删除事务失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+
+    // 每条语句以IN列表绑定本块的编号
+    auto prepareForKeys = [&](const QString& sql, const QStringList& bindKeys, int bindTimes) {
+        QString placeholders = QString("?,").repeated(bindKeys.size());
+        placeholders.chop(1);
+        query.prepare(QString(sql).replace("%KEYS%", placeholders));
+        for (int i = 0; i < bindTimes; ++i) {
+            for (const QString& key : bindKeys) {
+                query.addBindValue(key);
+            }
+        }
+    };
+
+    // 1. 仍存在、且没有未还借阅和留书的编号（借阅、预约均按(编号, 状态)索引查找）
+    prepareForKeys(QString("SELECT %1 FROM %2 WHERE %1 IN (%KEYS%) EXCEPT "
+                           "SELECT %1 FROM borrow WHERE %1 IN (%KEYS%) AND return_time IS NULL EXCEPT "
+                           "SELECT %1 FROM reservation WHERE %1 IN (%KEYS%) AND status = 'H'")
+                       .arg(keyColumn, table),
+                   keys, 3);
+    if (!query.exec()) {
         db.rollback();
-        qCritical() << "借阅记录无效/已归还：" << borrowId;
-        return false;
+        qCritical() << "查询待删除记录失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    QStringList removable;
+    while (query.next()) {
+        removable.append(query.value(0).toString());
+    }
+    *skipped = keys.size() - removable.size();
+    if (removable.isEmpty()) {
+        db.rollback();
+        return TxnStatus::Committed;
     }
-    QString bookId = query.value(0).toString();
 
-    // 2. 更新还书时间
-    query.prepare("UPDATE borrow SET return_time = CURRENT_TIMESTAMP WHERE id = ?");
-    query.addBindValue(borrowId);
+    // 2. 删除前的整行取值与关联记录数（审计说明与单行删除一致：字段=值; ...）
+    prepareForKeys(QString("SELECT t.*, "
+                           "(SELECT COUNT(*) FROM borrow WHERE borrow.%1 = t.%1), "
+                           "(SELECT COUNT(*) FROM reservation WHERE reservation.%1 = t.%1) "
+                           "FROM %2 t WHERE t.%1 IN (%KEYS%)").arg(keyColumn, table),
+                   removable, 1);
     if (!query.exec()) {
         db.rollback();
-        qCritical() << "更新还书时间失败：" << query.lastError().text();
-        return false;
+        qCritical() << "读取待删除记录失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    QVector<DeletedRow> rows;
+    while (query.next()) {
+        const QSqlRecord record = query.record();
+        const int fieldCount = record.count() - 2; // 末两列为关联借阅数、预约数
+        QStringList parts;
+        for (int i = 0; i < fieldCount; ++i) {
+            parts << QString("%1=%2").arg(record.fieldName(i), record.value(i).toString());
+        }
+        parts << QString("级联删除借阅记录%1条、预约%2条")
+                     .arg(record.value(fieldCount).toInt()).arg(record.value(fieldCount + 1).toInt());
+        rows.append({record.value(keyColumn).toString(), parts.join("; ")});
     }
 
-    // 3. 恢复图书库存
-    query.prepare("UPDATE book SET stock = stock + 1 WHERE book_id = ?");
-    query.addBindValue(bookId);
+    // 3. 等待中的预约（提交后移出预约队列）
+    prepareForKeys(QString("SELECT id FROM reservation WHERE %1 IN (%KEYS%) AND status = 'W'").arg(keyColumn),
+                   removable, 1);
     if (!query.exec()) {
         db.rollback();
-        qCritical() << "恢复库存失败：" << query.lastError().text();
-        return false;
+        qCritical() << "查询预约失败：" << query.lastError().text();
+        return TxnStatus::Failed;
+    }
+    while (query.next()) {
+        waiting->append(query.value(0).toInt());
+    }
+
+    // 4. 先删关联记录再删主表（连接未开启外键约束，级联由此处显式完成）
+    const QString deleteSqls[] = {QString("DELETE FROM reservation WHERE %1 IN (%KEYS%)").arg(keyColumn),
+                                  QString("DELETE FROM borrow WHERE %1 IN (%KEYS%)").arg(keyColumn),
+                                  QString("DELETE FROM %2 WHERE %1 IN (%KEYS%)").arg(keyColumn, table)};
+    for (const QString& deleteSql : deleteSqls) {
+        prepareForKeys(deleteSql, removable, 1);
+        if (!query.exec()) {
+            db.rollback();
+            qCritical() << "批量删除失败：" << query.lastError().text();
+            return TxnStatus::Failed;
+        }
     }
 
-    // 提交事务
     if (!db.commit()) {
+        const bool busy = isBusyError(db.lastError());
         db.rollback();
-        qCritical() << "提交还书事务失败：" << db.lastError().text();
-        return false;
+        if (busy) {
+            return TxnStatus::Busy;
+        }
+        qCritical() << "提交删除事务失败：" << db.lastError().text();
+        return TxnStatus::Failed;
+    }
+    *deleted = rows;
+    return TxnStatus::Committed;
+}
+
+bool DatabaseManager::readersActiveElsewhere(const QStringList& readerIds, QStringList* active) {
+    active->clear();
+    if (readerIds.isEmpty()) {
+        return true;
     }
+    QString placeholders = QString("?,").repeated(readerIds.size());
+    placeholders.chop(1);
+    const QString sql = QString("SELECT reader_id FROM borrow WHERE reader_id IN (%1) AND return_time IS NULL UNION "
+                                "SELECT reader_id FROM reservation WHERE reader_id IN (%1) AND status = 'H'")
+                            .arg(placeholders);
 
+    // 走各分片的读者索引；检查与本馆删除事务之间其他分片新借出的极少情况不在此防范
+    for (const ShardInfo& shard : m_shards) {
+        if (shard.index == m_currentShard) {
+            continue; // 本馆分片在删除事务内检查
+        }
+        QSqlQuery query(getReadDatabase(shard.index));
+        query.prepare(sql);
+        for (int i = 0; i < 2; ++i) {
+            for (const QString& readerId : readerIds) {
+                query.addBindValue(readerId);
+            }
+        }
+        if (!query.exec()) {
+            qCritical() << "查询其他分馆的借阅失败：" << shard.branch << query.lastError().text();
+            return false;
+        }
+        while (query.next()) {
+            const QString readerId = query.value(0).toString();
+            if (!active->contains(readerId)) {
+                active->append(readerId);
+            }
+        }
+    }
     return true;
 }
+
+int DatabaseManager::overdueLoanCount(int shardIndex) {
+    QSqlQuery query(getReadDatabase(shardIndex));
+    if (!query.exec(QString("SELECT COUNT(*) FROM borrow WHERE %1").arg(QLatin1String(OVERDUE_FILTER)))
+        || !query.next()) {
+        qWarning() << "统计逾期借阅失败：" << query.lastError().text();
+        return -1;
+    }
+    return query.value(0).toInt();
+}
+
+QVector<DatabaseManager::LoanDue> DatabaseManager::getActiveLoanDueTimes(bool* ok) {
+    TRACE_SCOPE("db", "DatabaseManager::getActiveLoanDueTimes");
+    QVector<LoanDue> loans;
+    if (ok) {
+        *ok = false;
+    }
+
+    for (const ShardInfo& shard : m_shards) {
+        // 独立只读连接，按列序号逐行解码为整数
+        SqliteConnection conn;
+        if (!conn.open(shard.filePath)) {
+            qCritical() << "打开只读连接失败：" << conn.errorMessage();
+            return loans;
+        }
+        SqliteStatement stmt(conn, "SELECT id, CAST(strftime('%s', due_time) AS INTEGER) FROM borrow "
+                                   "WHERE return_time IS NULL AND due_time IS NOT NULL");
+        LoanDueRecord record;
+        while (stmt.step()) {
+            stmt.decode(record);
+            loans.append({int(record.borrowId), record.dueSecs});
+        }
+        if (stmt.failed()) {
+            qCritical() << "查询未归还借阅失败：" << conn.errorMessage();
+            return loans;
+        }
+    }
+
+    if (ok) {
+        *ok = true;
+    }
+    return loans;
+}
+
+QVector<DatabaseManager::BookRow> DatabaseManager::searchBooks(const QString& keyword, bool* ok) {
+    TRACE_SCOPE("db", "DatabaseManager::searchBooks");
+    // 每个分片在独立线程、独立连接上查询，避免串行等待
+    QVector<QFuture<QVector<BookRow>>> futures;
+    QVector<bool> failed(m_shards.size(), false);
+    for (int i = 0; i < m_shards.size(); ++i) {
+        const ShardInfo shard = m_shards[i];
+        bool* shardFailed = &failed[i];
+        futures.append(QtConcurrent::run([shard, keyword, shardFailed]() {
+            TRACE_SCOPE("db", "DatabaseManager::searchShard");
+            QVector<BookRow> rows;
+            ScopedConnection conn(shard.filePath, true);
+            if (!conn.isOpen() || !conn.beginSnapshot()) {
+                *shardFailed = true;
+                return rows;
+            }
+            QSqlQuery query(conn.database());
+            query.setForwardOnly(true);
+            query.prepare("SELECT book_id, book_name, author, category, stock, total_copies FROM book "
+                          "WHERE book_id LIKE ? OR book_name LIKE ? OR author LIKE ? OR category LIKE ? "
+                          "ORDER BY book_id");
+            const QString pattern = "%" + keyword + "%";
+            for (int column = 0; column < 4; ++column) {
+                query.addBindValue(pattern);
+            }
+            if (!query.exec()) {
+                qCritical() << "分片检索失败：" << shard.branch << query.lastError().text();
+                *shardFailed = true;
+                return rows;
+            }
+            while (query.next()) {
+                rows.append({query.value(0).toString(), query.value(1).toString(),
+                             query.value(2).toString(), query.value(3).toString(),
+                             query.value(4).toInt(), query.value(5).toInt(), shard.index});
+            }
+            return rows;
+        }));
+    }
+
+    QVector<QVector<BookRow>> parts;
+    for (QFuture<QVector<BookRow>>& future : futures) {
+        parts.append(future.result());
+    }
+    if (ok) {
+        *ok = !failed.contains(true);
+    }
+    return mergeSortedParts(parts, [](const BookRow& a, const BookRow& b) {
+        return a.bookId < b.bookId;
+    });
+}
@@ -5,8 +5,52 @@
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QSqlTableModel>
+#include <QStandardItemModel>
 #include <QDebug>
 #include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <functional>
+#include "catalog_snapshot.h"
+#include "storage_profile.h"
+
+// 分馆分片：每个分馆一个数据库文件，借阅ID按分片划分号段以保证全局唯一
+struct ShardInfo {
+    int index;          // 分片序号（0为总馆，对应library.db）
+    QString branch;     // 分馆名称
+    QString filePath;   // 数据库文件路径
+};
+
+// 作用域连接：在当前线程打开独立连接，析构时关闭并移除（供并行查询使用，避免跨线程共用连接）
+// 只读连接以SQLITE_OPEN_READONLY打开并设置query_only，可开启快照使多条查询读到同一版本数据
+class ScopedConnection {
+public:
+    explicit ScopedConnection(const QString& filePath, bool readOnly = false);
+    ~ScopedConnection();
+
+    ScopedConnection(const ScopedConnection&) = delete;
+    ScopedConnection& operator=(const ScopedConnection&) = delete;
+
+    QSqlDatabase& database() { return m_db; }
+    bool isOpen() const { return m_db.isOpen(); }
+
+    // 开启读快照（WAL模式下读事务内的所有查询看到同一提交版本，析构时结束）
+    bool beginSnapshot();
+
+    // 当前持有读快照的连接数（检查点调度据此决定能否截断WAL）
+    static int activeSnapshots() { return s_activeSnapshots.loadAcquire(); }
+
+private:
+    QString m_name;
+    QSqlDatabase m_db;
+    bool m_inSnapshot = false;
+
+    static QAtomicInt s_activeSnapshots;
+};
 
 // 数据库管理单例类（确保唯一连接）
 class DatabaseManager {
@@ -21,31 +65,286 @@ public:
     DatabaseManager(const DatabaseManager&) = delete;
     DatabaseManager& operator=(const DatabaseManager&) = delete;
 
-    // 获取数据库连接
+    // 获取数据库连接（本馆分片）
     QSqlDatabase getDatabase();
 
-    // 初始化数据库表结构（程序启动时执行）
+    // 获取指定分片的写连接（仅限GUI线程，专供借还等写事务）
+    QSqlDatabase getShardDatabase(int shardIndex);
+
+    // 获取指定分片的只读连接（仅限GUI线程，供只读视图模型使用）
+    QSqlDatabase getReadDatabase(int shardIndex);
+
+    // 刷新模型：只取首批行，其余随视图滚动按需读取（未读完的游标持有读快照，检查点在工作线程上等待，不影响界面）
+    static bool selectModel(QSqlTableModel* model);
+
+    // 模型当前表与筛选条件下的总行数（按需读取时rowCount只是已取到的行数；统计失败返回已取行数）
+    static int countRows(QSqlTableModel* model);
+
+    // WAL检查点：无读快照时截断WAL，否则做不阻塞的被动检查点（由定时器周期调用，在工作线程上执行，立即返回）
+    void runScheduledCheckpoint();
+
+    // 初始化数据库表结构（程序启动时执行，覆盖所有分片；流通汇总的历史回填在工作线程上进行）
     bool initTables();
 
-    // 获取各模块的QSqlTableModel（供UI层绑定）
-    QSqlTableModel* getBookModel(QObject* parent = nullptr);
+    // 等待启动时的流通汇总回填结束（cancel为true时先让回填尽快放弃，退出程序前调用）
+    void waitForRollupBackfill(bool cancel = false);
+
+    // 设置总馆数据库文件路径（须在首次取连接前调用，默认library.db）
+    void setDatabasePath(const QString& path) { m_databasePath = path; }
+
+    // 存储配置档（须在首次取连接前设置，默认durable）；只读连接与批量读取连接按同一档设置缓存与内存映射
+    void setStorageProfile(const StorageProfile& profile);
+    const StorageProfile& storageProfile() const { return *m_storageProfile; }
+
+    // 审计日志目录（与总馆数据库文件相邻）
+    QString auditLogDirectory() const { return m_databasePath + AUDIT_LOG_SUFFIX; }
+
+    // 并发写冲突处理：忙等待超时（毫秒，须在首次取连接前设置）与事务重试策略
+    struct RetryPolicy {
+        int maxAttempts = 10;   // 含首次尝试（每次尝试只短暂忙等待，总耐心主要来自退避）
+        int baseDelayMs = 10;   // 退避基数
+        int maxDelayMs = 500;   // 单次退避上限
+    };
+    void setBusyTimeout(int ms) { m_busyTimeoutMs = ms; }
+    int busyTimeout() const { return m_busyTimeoutMs; }
+    void setRetryPolicy(const RetryPolicy& policy) { m_retryPolicy = policy; }
+
+    // 写冲突统计（借还事务次数、重试次数、重试耗尽次数、冲突累计耗时）
+    struct ContentionStats {
+        quint64 transactions = 0;
+        quint64 retries = 0;
+        quint64 busyFailures = 0;
+        qint64 contentionMs = 0;
+    };
+    ContentionStats contentionStats() const;
+
+    // 最近一次借还是否因数据库繁忙失败（供界面给出针对性提示）
+    bool lastOperationBusy() const { return m_lastOperationBusy; }
+
+    // 最近一次借书是否因库存不足失败（界面据此提示登记预约）
+    bool lastBorrowOutOfStock() const { return m_lastBorrowOutOfStock; }
+
+    // 设置本馆（须在initTables前调用；分馆不存在时自动创建分片）
+    void setCurrentBranch(const QString& branch) { m_currentBranchName = branch; }
+
+    // 新增分馆分片
+    bool addBranch(const QString& branch);
+
+    // 扫描数据库目录，登记所有分馆分片（只读打开各分片取分馆名，不建表、不升级；initTables首先调用）
+    bool loadShards();
+
+    // 分片信息
+    const QVector<ShardInfo>& shards() const { return m_shards; }
+    int shardCount() const { return m_shards.size(); }
+    int currentShard() const { return m_currentShard; }
+    QString branchName(int shardIndex) const;
+
+    // 定位数据所属分片（未找到返回-1）
+    int shardOfBorrow(int borrowId) const;
+    int findBookShard(const QString& bookId);
+    int findReaderShard(const QString& readerId);
+
+    // 获取各模块的QSqlTableModel（供UI层绑定；图书模型可推迟首次查询，先以目录快照显示）
+    QSqlTableModel* getBookModel(QObject* parent = nullptr, bool select = true);
     QSqlTableModel* getReaderModel(QObject* parent = nullptr);
     QSqlTableModel* getBorrowModel(QObject* parent = nullptr);
 
-    // 核心业务：借书（含库存校验+事务）
+    // 核心业务：借书（含库存校验+事务；读者有留书时直接取走留出的副本）
     bool borrowBook(const QString& bookId, const QString& readerId);
 
-    // 核心业务：还书（含库存恢复+事务）
-    bool returnBook(int borrowId);
+    // 还书时副本的去向：留给预约读者（reservationId>0）或回库
+    struct HoldAssignment {
+        int reservationId = 0;
+        QString readerId;
+    };
+
+    // 核心业务：还书（含库存恢复+事务；有人预约时副本在同一事务内留给队首读者）
+    bool returnBook(int borrowId, HoldAssignment* hold = nullptr);
+
+    // 预约：登记到图书所属分片，waitingCount返回登记后该书的等待人数
+    bool reserveBook(const QString& bookId, const QString& readerId, int* waitingCount = nullptr);
+
+    // 取消预约（已留书的副本转给下一位或回库）
+    bool cancelReservation(int shardIndex, int reservationId);
+
+    // 处理所有分片中留书期限已过的预约（由预约队列定时调用），返回过期条数
+    int expireHolds();
+
+    // 预约队列模型及刷新：列出所有分片的有效预约（读者可在其他分馆预约），
+    // 首列的Qt::UserRole为预约所在分片，多分馆时追加所属分馆列
+    QStandardItemModel* getReservationModel(QObject* parent = nullptr);
+    bool refreshReservationModel(QStandardItemModel* model);
+
+    // 批量删除结果（失败或中止时已提交的块保留）
+    struct BulkDeleteResult {
+        int deleted = 0;   // 已删除条数
+        int skipped = 0;   // 有未还借阅或留书而跳过的条数
+        bool ok = true;
+    };
+    // 进度回调：(已处理, 总数)，返回false时在块边界停止
+    using BulkProgress = std::function<bool(int done, int total)>;
+
+    // 批量删除本馆图书/读者：按块分事务，关联的借阅记录与预约在同一事务内按索引删除
+    // 有未还借阅或留书的跳过（删除会使库存与到期提醒失去依据），须先还书或取消预约
+    BulkDeleteResult deleteBooks(const QStringList& bookIds, const BulkProgress& progress = BulkProgress());
+    BulkDeleteResult deleteReaders(const QStringList& readerIds, const BulkProgress& progress = BulkProgress());
+
+    // 逾期条件（借阅表筛选用，走应还时间索引；以库中状态为准，其他终端的借还即时反映）
+    static constexpr const char* OVERDUE_FILTER = "return_time IS NULL AND due_time <= datetime('now')";
+
+    // 指定分片当前逾期未还的借阅数（只读连接），失败返回-1
+    int overdueLoanCount(int shardIndex);
+
+    // 未归还借阅的应还时间（供逾期调度器加载）
+    struct LoanDue {
+        int borrowId;
+        qint64 dueSecs; // Unix时间戳（秒）
+    };
+    QVector<LoanDue> getActiveLoanDueTimes(bool* ok = nullptr);
+
+    // 跨分片图书检索：各分片并行查询，按图书编号归并
+    struct BookRow {
+        QString bookId;
+        QString bookName;
+        QString author;
+        QString category;
+        int stock;
+        int totalCopies;
+        int shard;
+    };
+    QVector<BookRow> searchBooks(const QString& keyword, bool* ok = nullptr);
+
+    // 变更探测（只读连接）：data_version仅在其他连接或进程提交后变化，轮询代价为一次PRAGMA
+    qint64 dataVersion(int shardIndex);
+
+    // 变更日志（由触发器写入）：按序号增量读取指定表自游标之后的变更
+    struct ChangeEntry {
+        qint64 seq;
+        QString rowKey;
+        QChar op; // I新增 / U更新 / D删除
+    };
+    qint64 latestChangeSeq(int shardIndex);
+    bool readChanges(int shardIndex, const QString& table, qint64 afterSeq, int limit,
+                     QVector<ChangeEntry>* entries, qint64* oldestSeq);
+
+    // 本馆目录快照：编号集合仍与库中一致时返回（按编号查找使用），缺失或有增删时返回nullptr；
+    // 过期时在后台重新生成，完成后于下次调用时换入
+    const CatalogSnapshot* catalogSnapshot();
+
+    // 内容（含库存）也与库中一致时才返回（图书面板首屏使用）
+    const CatalogSnapshot* currentCatalogSnapshot();
+
+    // 重新生成目录快照（仅在缺失或过期时写文件，退出时调用，下次启动即可映射使用）
+    bool saveCatalogSnapshot();
 
 private:
     // 私有构造/析构（单例）
-    DatabaseManager() = default;
+    DatabaseManager();
     ~DatabaseManager() = default;
 
+    // 单次事务尝试结果：繁忙时由runWithRetry退避后重试（退避在事件循环里等待，不阻塞界面）
+    enum class TxnStatus { Committed, Busy, Failed };
+    static bool isBusyError(const QSqlError& error);
+    bool runWithRetry(QSqlDatabase& db, const std::function<TxnStatus()>& attempt, const char* operation);
+    TxnStatus tryBorrowBook(QSqlDatabase& db, const QString& bookId, const QString& readerId,
+                            int* borrowId, qint64* dueSecs, QVector<int>* fulfilled, bool* fromHold);
+    TxnStatus tryReturnBook(QSqlDatabase& db, int shardIndex, int borrowId, QString* bookId, QString* readerId,
+                            bool* overdue, HoldAssignment* hold);
+    TxnStatus tryReserveBook(QSqlDatabase& db, const QString& bookId, const QString& readerId, int priority,
+                             int* reservationId);
+    TxnStatus tryCloseReservation(QSqlDatabase& db, int shardIndex, int reservationId, QChar status,
+                                  QString* bookId, QString* readerId, QChar* oldStatus, HoldAssignment* next);
+
+    // 归还/释放的副本：留给预约队首读者，无人等待时恢复库存（须在写事务内调用）
+    bool allocateCopy(QSqlDatabase& db, int shardIndex, const QString& bookId, HoldAssignment* hold);
+
+    // 结束预约：status为C（取消）或X（过期，仅处理已到期的留书）
+    bool closeReservation(int shardIndex, int reservationId, QChar status);
+
+    // 批量删除：table的主键列与借阅表、预约表的外键列同名
+    struct DeletedRow {
+        QString key;
+        QString detail; // 删除前的整行取值及级联删除的关联记录数（审计说明）
+    };
+    BulkDeleteResult bulkDelete(const QString& table, const QString& keyColumn, const QStringList& keys,
+                                const BulkProgress& progress);
+    TxnStatus tryDeleteChunk(QSqlDatabase& db, const QString& table, const QString& keyColumn,
+                             const QStringList& keys, QVector<DeletedRow>* deleted, int* skipped,
+                             QVector<int>* waiting);
+
+    // 读者可在其他分馆借书和取留书：在本馆以外的分片仍有未还借阅或留书的读者编号
+    bool readersActiveElsewhere(const QStringList& readerIds, QStringList* active);
+
+    // 预约状态变化记入审计日志
+    void auditReservation(int shardIndex, int reservationId, const QString& bookId, const QString& readerId,
+                          const QString& detail);
+
+    // 在单个分片上建表/升级
+    bool initShardTables(QSqlDatabase& db);
+
+    QString shardConnectionName(int shardIndex) const;
+    QString shardFilePath(int shardIndex) const;
+
+    // 目录快照：启动时映射；按变更日志判断生成后图书/读者是否有改动
+    QString catalogSnapshotPath() const;
+    bool loadCatalogSnapshot();
+    void updateCatalogState();
+    void scheduleCatalogRebuild();
+    void installRebuiltCatalog();
+    // 快照序号之后图书/读者有无增删（idsChanged）、有无任何改动（contentChanged）；查询失败时两者均为true
+    bool catalogChangesSince(qint64 changeSeq, bool* idsChanged, bool* contentChanged);
+
+    // 清理过旧的变更日志（保留最近CHANGE_LOG_RETAIN条）
+    bool pruneChangeLog(QSqlDatabase& db);
+
+    // 连接打开后的统一配置（存储配置档、日志大小上限等）
+    bool configureWriter(QSqlDatabase& db);
+
+    // 旧库结构升级（按表结构描述补齐缺失列，可重复执行）
+    bool migrateSchema(QSqlDatabase& db);
+
     // 常量定义（避免魔法值）
     const QString CONNECTION_NAME = "library_sqlite_conn";
     const QString DB_NAME = "library.db";
+    const int LOAN_DAYS = 30; // 默认借期（天）
+    const int HOLD_DAYS = 3;  // 预约留书期限（天），逾期未取转给下一位
+    const QString MAIN_BRANCH = "总馆";
+    const QString SHARD_FILE_PREFIX = "library_shard"; // 分馆分片文件：library_shard<序号>.db
+    const int SHARD_ID_SPAN = 100000000; // 每个分片的借阅ID号段
+    const int CHANGE_LOG_RETAIN = 100000; // 变更日志保留条数，落后更多的终端整表刷新
+    const int BULK_DELETE_CHUNK = 300; // 批量删除每个事务的条数（筛选语句绑定三遍，不超过SQLite默认999个参数）
+    const QString CATALOG_SNAPSHOT_SUFFIX = ".catalog"; // 目录快照文件：<分片文件>.catalog
+    const QString CATALOG_PENDING_SUFFIX = ".new"; // 后台生成的快照先写到<快照文件>.new，换入时改名
+    const int CATALOG_STALE_REBUILD_MS = 5000;     // 编号集合变化后重建快照的最短间隔
+    const int CATALOG_REBUILD_INTERVAL_MS = 60000; // 只有内容变化时重建快照的最短间隔
+    const QString AUDIT_LOG_SUFFIX = ".audit"; // 审计日志目录：<总馆文件>.audit
+    const int ATTEMPT_BUSY_TIMEOUT_MS = 50; // 借还事务每次尝试在SQLite内忙等待的上限（界面线程）
+    const qint64 WAL_SIZE_LIMIT = 64 * 1024 * 1024; // 检查点后WAL文件保留的上限（字节）
+
+    QString m_databasePath = DB_NAME;
+    int m_busyTimeoutMs = 2000;
+    const StorageProfile* m_storageProfile = &StorageProfile::defaultProfile();
+    RetryPolicy m_retryPolicy;
+    bool m_lastOperationBusy = false;
+    bool m_lastBorrowOutOfStock = false;
+    QAtomicInteger<quint64> m_statTransactions{0};
+    QAtomicInteger<quint64> m_statRetries{0};
+    QAtomicInteger<quint64> m_statBusyFailures{0};
+    QAtomicInteger<qint64> m_statContentionMs{0};
+    QAtomicInt m_checkpointRunning{0}; // 检查点工作线程是否在执行
+    QFuture<void> m_rollupBackfill;    // 启动时的流通汇总回填
+
+    QVector<ShardInfo> m_shards;
+    int m_currentShard = 0;
+    QString m_currentBranchName;
+
+    CatalogSnapshot m_catalogSnapshot;
+    bool m_catalogStale = true;        // 编号集合已变或快照缺失，不能用于查找
+    bool m_catalogContentStale = true; // 内容已变（如库存），不能作首屏
+    qint64 m_catalogDataVersion = -1;
+    QFuture<bool> m_catalogRebuild;    // 后台重新生成
+    bool m_catalogRebuildPending = false;
+    QElapsedTimer m_catalogBuildAge;   // 距上次开始重建的时长
 };
 
 #endif // DATABASE_MANAGER_H
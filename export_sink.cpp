@@ -0,0 +1,565 @@
+#include "export_sink.h"
+#include "trace.h"
+#include <QDebug>
+#include <QHash>
+#include <QThread>
+#include <QtEndian>
+#include <charconv>
+#include <cstring>
+#include <vector>
+#include <zlib.h>
+#ifdef ZHXM_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+const int BLOCK_SIZE = 1 << 20; // 写设备/送压缩器的块大小
+const int GZIP_LEVEL = 6;
+const int ZSTD_LEVEL = 3;
+
+// 字节流：编码器直接向缓冲追加，攒满一块后整块交给下层（直写或压缩）
+class ByteStream {
+public:
+    explicit ByteStream(QIODevice* device) : m_device(device) {
+        m_buffer.reserve(BLOCK_SIZE + BLOCK_SIZE / 8);
+    }
+    virtual ~ByteStream() = default;
+
+    QByteArray& buffer() { return m_buffer; }
+
+    // 每写完一行调用：缓冲满一块时送出
+    bool commit() { return m_buffer.size() < BLOCK_SIZE || flush(); }
+
+    bool finish() { return flush() && endStream(); }
+
+protected:
+    virtual bool writeBlock(const char* data, int size) = 0;
+    virtual bool endStream() { return true; }
+
+    bool writeDevice(const char* data, qint64 size) {
+        if (m_device->write(data, size) != size) {
+            qCritical() << "写入导出文件失败：" << m_device->errorString();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool flush() {
+        const bool ok = m_buffer.isEmpty() || writeBlock(m_buffer.constData(), m_buffer.size());
+        m_buffer.resize(0);
+        return ok;
+    }
+
+    QIODevice* m_device;
+    QByteArray m_buffer;
+};
+
+class PlainStream : public ByteStream {
+public:
+    using ByteStream::ByteStream;
+
+protected:
+    bool writeBlock(const char* data, int size) override { return writeDevice(data, size); }
+};
+
+// gzip流式压缩（zlib deflate，windowBits+16输出gzip封装）
+class GzipStream : public ByteStream {
+public:
+    explicit GzipStream(QIODevice* device) : ByteStream(device), m_out(BLOCK_SIZE, Qt::Uninitialized) {
+        std::memset(&m_zs, 0, sizeof(m_zs));
+        m_valid = deflateInit2(&m_zs, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+    ~GzipStream() override {
+        if (m_valid) {
+            deflateEnd(&m_zs);
+        }
+    }
+
+    bool isValid() const { return m_valid; }
+
+protected:
+    bool writeBlock(const char* data, int size) override { return deflateBlock(data, size, Z_NO_FLUSH); }
+    bool endStream() override { return deflateBlock(nullptr, 0, Z_FINISH); }
+
+private:
+    bool deflateBlock(const char* data, int size, int flush) {
+        m_zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        m_zs.avail_in = uInt(size);
+        int status = Z_OK;
+        do {
+            m_zs.next_out = reinterpret_cast<Bytef*>(m_out.data());
+            m_zs.avail_out = uInt(m_out.size());
+            status = deflate(&m_zs, flush);
+            if (status == Z_STREAM_ERROR) {
+                qCritical() << "gzip压缩失败";
+                return false;
+            }
+            const int produced = m_out.size() - int(m_zs.avail_out);
+            if (produced > 0 && !writeDevice(m_out.constData(), produced)) {
+                return false;
+            }
+        } while (m_zs.avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+        return true;
+    }
+
+    z_stream m_zs;
+    QByteArray m_out;
+    bool m_valid = false;
+};
+
+#ifdef ZHXM_HAVE_ZSTD
+// zstd流式压缩（libzstd以多线程构建时由其工作线程并行压缩）
+class ZstdStream : public ByteStream {
+public:
+    explicit ZstdStream(QIODevice* device)
+        : ByteStream(device), m_cctx(ZSTD_createCCtx()), m_out(int(ZSTD_CStreamOutSize()), Qt::Uninitialized) {
+        if (m_cctx) {
+            ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_compressionLevel, ZSTD_LEVEL);
+            ZSTD_CCtx_setParameter(m_cctx, ZSTD_c_nbWorkers, QThread::idealThreadCount()); // 单线程库会忽略
+        }
+    }
+    ~ZstdStream() override { ZSTD_freeCCtx(m_cctx); }
+
+    bool isValid() const { return m_cctx != nullptr; }
+
+protected:
+    bool writeBlock(const char* data, int size) override { return compressBlock(data, size, ZSTD_e_continue); }
+    bool endStream() override { return compressBlock(nullptr, 0, ZSTD_e_end); }
+
+private:
+    bool compressBlock(const char* data, int size, ZSTD_EndDirective mode) {
+        ZSTD_inBuffer input{data, std::size_t(size), 0};
+        for (;;) {
+            ZSTD_outBuffer output{m_out.data(), std::size_t(m_out.size()), 0};
+            const std::size_t remaining = ZSTD_compressStream2(m_cctx, &output, &input, mode);
+            if (ZSTD_isError(remaining)) {
+                qCritical() << "zstd压缩失败：" << ZSTD_getErrorName(remaining);
+                return false;
+            }
+            if (output.pos > 0 && !writeDevice(m_out.constData(), qint64(output.pos))) {
+                return false;
+            }
+            if (mode == ZSTD_e_end ? remaining == 0 : input.pos == input.size) {
+                return true;
+            }
+        }
+    }
+
+    ZSTD_CCtx* m_cctx;
+    QByteArray m_out;
+};
+#endif
+
+std::string_view viewOf(const QByteArray& bytes) {
+    return std::string_view(bytes.constData(), std::size_t(bytes.size()));
+}
+
+// CSV：首行为列名
+class CsvSink : public ExportSink {
+public:
+    explicit CsvSink(std::unique_ptr<ByteStream> stream) : m_stream(std::move(stream)) {}
+
+    bool begin(const QVector<ExportColumn>& columns) override {
+        m_columnCount = columns.size();
+        QByteArray& out = m_stream->buffer();
+        for (int i = 0; i < m_columnCount; ++i) {
+            if (i > 0) {
+                out += ',';
+            }
+            appendCsvField(out, viewOf(columns[i].name));
+        }
+        out += '\n';
+        return m_stream->commit();
+    }
+
+    bool writeRow(const std::string_view* fields) override {
+        QByteArray& out = m_stream->buffer();
+        for (int i = 0; i < m_columnCount; ++i) {
+            if (i > 0) {
+                out += ',';
+            }
+            appendCsvField(out, fields[i]);
+        }
+        out += '\n';
+        return m_stream->commit();
+    }
+
+    bool finish() override { return m_stream->finish(); }
+
+private:
+    std::unique_ptr<ByteStream> m_stream;
+    int m_columnCount = 0;
+};
+
+// JSON字符串转义：双引号、反斜杠与控制字符，其余UTF-8字节原样输出
+void appendJsonString(QByteArray& out, std::string_view text) {
+    static const char HEX[] = "0123456789abcdef";
+    out += '"';
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        const unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(text.data() + start, int(i - start));
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            out += "\\u00";
+            out += HEX[c >> 4];
+            out += HEX[c & 0xF];
+            break;
+        }
+        start = i + 1;
+    }
+    out.append(text.data() + start, int(text.size() - start));
+    out += '"';
+}
+
+// 是否为合法的JSON整数（数值列中混入的非数字文本仍按字符串输出）
+bool isJsonInteger(std::string_view text) {
+    std::size_t i = (!text.empty() && text[0] == '-') ? 1 : 0;
+    if (i >= text.size() || (text[i] == '0' && i + 1 < text.size())) {
+        return false;
+    }
+    for (; i < text.size(); ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// JSON Lines：每行一个对象，键名在begin时预先编码
+class JsonLinesSink : public ExportSink {
+public:
+    explicit JsonLinesSink(std::unique_ptr<ByteStream> stream) : m_stream(std::move(stream)) {}
+
+    bool begin(const QVector<ExportColumn>& columns) override {
+        m_keys.clear();
+        m_numeric.clear();
+        for (int i = 0; i < columns.size(); ++i) {
+            QByteArray key(i == 0 ? "{" : ",");
+            appendJsonString(key, viewOf(columns[i].name));
+            key += ':';
+            m_keys.append(key);
+            m_numeric.append(columns[i].numeric);
+        }
+        return true;
+    }
+
+    bool writeRow(const std::string_view* fields) override {
+        QByteArray& out = m_stream->buffer();
+        for (int i = 0; i < m_keys.size(); ++i) {
+            out += m_keys[i];
+            if (!fields[i].data()) {
+                out += "null";
+            } else if (m_numeric[i] && isJsonInteger(fields[i])) {
+                out.append(fields[i].data(), int(fields[i].size()));
+            } else {
+                appendJsonString(out, fields[i]);
+            }
+        }
+        out += m_keys.isEmpty() ? "{}\n" : "}\n";
+        return m_stream->commit();
+    }
+
+    bool finish() override { return m_stream->finish(); }
+
+private:
+    std::unique_ptr<ByteStream> m_stream;
+    QVector<QByteArray> m_keys;
+    QVector<bool> m_numeric;
+};
+
+template <typename T>
+void appendLittleEndian(QByteArray& out, T value) {
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&value), int(sizeof(value)));
+}
+
+template <typename T>
+void appendLittleEndianArray(QByteArray& out, const std::vector<T>& values) {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    out.append(reinterpret_cast<const char*>(values.data()), int(values.size() * sizeof(T)));
+#else
+    for (T value : values) {
+        appendLittleEndian(out, value);
+    }
+#endif
+}
+
+// 列分块二进制格式（小端）：
+//   文件头：魔数"ZHXMCOL1"，u32版本，u32列数，逐列 u8类型(0文本/1整数) u32名称长度 名称
+//   数据块：u32行数(>0)，随后逐列：NULL位图((行数+7)/8字节，置位为NULL)，再按类型：
+//     整数列：行数×i64
+//     文本列：u8编码方式
+//       0明文：u32字节数，行数×u32结束偏移，字节
+//       1字典：u32字典项数，u32字典字节数，项数×u32结束偏移，字节，u8编码宽度(1/2)，行数×编码
+//   文件尾：u32 0，u64总行数，u32块数，魔数
+// 字典按块独立构建：块内重复值（分类、作者、状态、分馆等）只存一次；不同值过多时该列本块退化为明文
+class ColumnarSink : public ExportSink {
+public:
+    explicit ColumnarSink(std::unique_ptr<ByteStream> stream) : m_stream(std::move(stream)) {}
+
+    bool begin(const QVector<ExportColumn>& columns) override {
+        QByteArray& out = m_stream->buffer();
+        out.append(MAGIC, int(sizeof(MAGIC)));
+        appendLittleEndian<quint32>(out, FORMAT_VERSION);
+        appendLittleEndian<quint32>(out, quint32(columns.size()));
+        m_columns.clear();
+        m_columns.resize(columns.size());
+        for (int i = 0; i < columns.size(); ++i) {
+            m_columns[i].numeric = columns[i].numeric;
+            out += char(columns[i].numeric ? 1 : 0);
+            appendLittleEndian<quint32>(out, quint32(columns[i].name.size()));
+            out += columns[i].name;
+        }
+        return m_stream->commit();
+    }
+
+    bool writeRow(const std::string_view* fields) override {
+        for (int i = 0; i < m_columns.size(); ++i) {
+            appendValue(m_columns[i], fields[i]);
+        }
+        ++m_chunkRows;
+        return (m_chunkRows < CHUNK_ROWS && m_chunkBytes < CHUNK_BYTES) || flushChunk();
+    }
+
+    bool finish() override {
+        if (m_chunkRows > 0 && !flushChunk()) {
+            return false;
+        }
+        QByteArray& out = m_stream->buffer();
+        appendLittleEndian<quint32>(out, 0);
+        appendLittleEndian<quint64>(out, m_totalRows);
+        appendLittleEndian<quint32>(out, m_chunkCount);
+        out.append(MAGIC, int(sizeof(MAGIC)));
+        return m_stream->finish();
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'Z', 'H', 'X', 'M', 'C', 'O', 'L', '1'};
+    static constexpr quint32 FORMAT_VERSION = 1;
+    static constexpr int CHUNK_ROWS = 65536;          // 每块行数上限
+    static constexpr qint64 CHUNK_BYTES = 16 * 1024 * 1024; // 每块文本字节上限（长文本时提前成块，内存有界且偏移不溢出u32）
+    static constexpr int MAX_DICTIONARY = CHUNK_ROWS / 4; // 字典项上限（超过则本块该列改为明文）
+
+    struct Column {
+        bool numeric = false;
+        QByteArray nulls;
+        std::vector<qint64> integers;
+        bool useDictionary = true;
+        QHash<QByteArray, quint32> dictionary;
+        QByteArray dictBytes;
+        std::vector<quint32> dictEnds;
+        std::vector<quint32> codes;
+        QByteArray bytes;
+        std::vector<quint32> ends;
+    };
+
+    void appendValue(Column& column, std::string_view field) {
+        const int row = m_chunkRows;
+        m_chunkBytes += qint64(field.size());
+        if (row % 8 == 0) {
+            column.nulls += '\0';
+        }
+        if (!field.data()) {
+            column.nulls[row / 8] = char(column.nulls[row / 8] | (1 << (row % 8)));
+            field = std::string_view("", 0);
+        }
+
+        if (column.numeric) {
+            qint64 value = 0;
+            const auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+            if (result.ec != std::errc()) {
+                column.nulls[row / 8] = char(column.nulls[row / 8] | (1 << (row % 8))); // 非数字按NULL处理
+            }
+            column.integers.push_back(value);
+            return;
+        }
+
+        if (column.useDictionary) {
+            const auto it = column.dictionary.constFind(QByteArray::fromRawData(field.data(), int(field.size())));
+            if (it != column.dictionary.constEnd()) {
+                column.codes.push_back(it.value());
+                return;
+            }
+            if (column.dictionary.size() < MAX_DICTIONARY) {
+                const quint32 code = quint32(column.dictEnds.size());
+                column.dictBytes.append(field.data(), int(field.size()));
+                column.dictEnds.push_back(quint32(column.dictBytes.size()));
+                column.dictionary.insert(QByteArray(field.data(), int(field.size())), code);
+                column.codes.push_back(code);
+                return;
+            }
+            switchToPlain(column);
+        }
+        column.bytes.append(field.data(), int(field.size()));
+        column.ends.push_back(quint32(column.bytes.size()));
+    }
+
+    // 字典项过多：把已编码的值展开为明文，本块余下的行直接追加明文
+    static void switchToPlain(Column& column) {
+        for (quint32 code : column.codes) {
+            const quint32 begin = code == 0 ? 0 : column.dictEnds[code - 1];
+            column.bytes.append(column.dictBytes.constData() + begin, int(column.dictEnds[code] - begin));
+            column.ends.push_back(quint32(column.bytes.size()));
+        }
+        column.useDictionary = false;
+        column.dictionary.clear();
+        column.dictBytes.clear();
+        column.dictEnds.clear();
+        column.codes.clear();
+    }
+
+    bool flushChunk() {
+        TRACE_SCOPE("export", "ColumnarSink::flushChunk");
+        QByteArray& out = m_stream->buffer();
+        appendLittleEndian<quint32>(out, quint32(m_chunkRows));
+        for (Column& column : m_columns) {
+            out += column.nulls;
+            if (column.numeric) {
+                appendLittleEndianArray(out, column.integers);
+            } else if (column.useDictionary) {
+                out += char(1);
+                appendLittleEndian<quint32>(out, quint32(column.dictEnds.size()));
+                appendLittleEndian<quint32>(out, quint32(column.dictBytes.size()));
+                appendLittleEndianArray(out, column.dictEnds);
+                out += column.dictBytes;
+                // 编码宽度按字典大小取1或2字节
+                if (column.dictEnds.size() <= 256) {
+                    out += char(1);
+                    for (quint32 code : column.codes) {
+                        out += char(code);
+                    }
+                } else {
+                    out += char(2);
+                    for (quint32 code : column.codes) {
+                        appendLittleEndian<quint16>(out, quint16(code));
+                    }
+                }
+            } else {
+                out += char(0);
+                appendLittleEndian<quint32>(out, quint32(column.bytes.size()));
+                appendLittleEndianArray(out, column.ends);
+                out += column.bytes;
+            }
+            const bool numeric = column.numeric;
+            column = Column();
+            column.numeric = numeric;
+        }
+        m_totalRows += quint64(m_chunkRows);
+        ++m_chunkCount;
+        m_chunkRows = 0;
+        m_chunkBytes = 0;
+        return m_stream->commit();
+    }
+
+    std::unique_ptr<ByteStream> m_stream;
+    QVector<Column> m_columns;
+    int m_chunkRows = 0;
+    qint64 m_chunkBytes = 0;
+    quint64 m_totalRows = 0;
+    quint32 m_chunkCount = 0;
+};
+
+} // namespace
+
+std::unique_ptr<ExportSink> ExportSink::create(ExportFormat format, QIODevice* device) {
+    switch (format) {
+    case ExportFormat::Csv:
+        return std::make_unique<CsvSink>(std::make_unique<PlainStream>(device));
+    case ExportFormat::CsvGzip: {
+        auto stream = std::make_unique<GzipStream>(device);
+        if (!stream->isValid()) {
+            qCritical() << "初始化gzip压缩失败";
+            return nullptr;
+        }
+        return std::make_unique<CsvSink>(std::move(stream));
+    }
+    case ExportFormat::CsvZstd: {
+#ifdef ZHXM_HAVE_ZSTD
+        auto stream = std::make_unique<ZstdStream>(device);
+        if (!stream->isValid()) {
+            qCritical() << "初始化zstd压缩失败";
+            return nullptr;
+        }
+        return std::make_unique<CsvSink>(std::move(stream));
+#else
+        qCritical() << "当前构建未启用zstd（需安装libzstd后重新构建）";
+        return nullptr;
+#endif
+    }
+    case ExportFormat::JsonLines:
+        return std::make_unique<JsonLinesSink>(std::make_unique<PlainStream>(device));
+    case ExportFormat::Columnar:
+        return std::make_unique<ColumnarSink>(std::make_unique<PlainStream>(device));
+    }
+    return nullptr;
+}
+
+QVector<ExportFormat> ExportSink::availableFormats() {
+    QVector<ExportFormat> formats{ExportFormat::Csv, ExportFormat::CsvGzip};
+#ifdef ZHXM_HAVE_ZSTD
+    formats << ExportFormat::CsvZstd;
+#endif
+    formats << ExportFormat::JsonLines << ExportFormat::Columnar;
+    return formats;
+}
+
+QString ExportSink::displayName(ExportFormat format) {
+    switch (format) {
+    case ExportFormat::Csv: return "CSV文件 (*.csv)";
+    case ExportFormat::CsvGzip: return "gzip压缩CSV (*.csv.gz)";
+    case ExportFormat::CsvZstd: return "zstd压缩CSV (*.csv.zst)";
+    case ExportFormat::JsonLines: return "JSON Lines (*.jsonl)";
+    case ExportFormat::Columnar: return "列式二进制 (*.zcol)";
+    }
+    return QString();
+}
+
+QString ExportSink::fileSuffix(ExportFormat format) {
+    switch (format) {
+    case ExportFormat::Csv: return ".csv";
+    case ExportFormat::CsvGzip: return ".csv.gz";
+    case ExportFormat::CsvZstd: return ".csv.zst";
+    case ExportFormat::JsonLines: return ".jsonl";
+    case ExportFormat::Columnar: return ".zcol";
+    }
+    return QString();
+}
+
+ExportFormat ExportSink::formatForPath(const QString& path) {
+    for (ExportFormat format : availableFormats()) {
+        if (format != ExportFormat::Csv && path.endsWith(fileSuffix(format), Qt::CaseInsensitive)) {
+            return format;
+        }
+    }
+    return ExportFormat::Csv;
+}
+
+void ExportSink::appendCsvField(QByteArray& out, std::string_view field) {
+    // 处理CSV特殊字符：逗号、双引号、换行
+    const bool needsQuote = field.find_first_of(",\"\n\r") != std::string_view::npos;
+    if (!needsQuote) {
+        out.append(field.data(), int(field.size()));
+        return;
+    }
+
+    out += '"'; // 包含特殊字符则包裹双引号
+    std::size_t start = 0;
+    for (std::size_t quote = field.find('"'); quote != std::string_view::npos; quote = field.find('"', start)) {
+        out.append(field.data() + start, int(quote - start + 1));
+        out += '"'; // 双引号转义为两个
+        start = quote + 1;
+    }
+    out.append(field.data() + start, int(field.size() - start));
+    out += '"';
+}
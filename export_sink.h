@@ -0,0 +1,54 @@
+#ifndef EXPORT_SINK_H
+#define EXPORT_SINK_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <QVector>
+#include <memory>
+#include <string_view>
+
+// 导出格式
+enum class ExportFormat {
+    Csv,        // 纯文本CSV（.csv）
+    CsvGzip,    // gzip流式压缩CSV（.csv.gz）
+    CsvZstd,    // zstd流式压缩CSV（.csv.zst，需以libzstd构建）
+    JsonLines,  // 每行一个JSON对象（.jsonl）
+    Columnar,   // 列分块二进制（.zcol），块内每列独立选择字典或明文编码
+};
+
+// 导出列：numeric列在JSON Lines中输出为数字，在列式格式中按64位整数存储
+struct ExportColumn {
+    QByteArray name;
+    bool numeric;
+};
+
+// 导出接收端：逐行接收字段并编码，攒满大块后整块写出（压缩格式流式压缩，不在内存中积累整个文件）
+// 字段以string_view传入，仅在本次调用内有效；data()为nullptr表示NULL
+class ExportSink {
+public:
+    virtual ~ExportSink() = default;
+
+    // 按格式创建接收端（设备须已打开，且在finish之前保持有效）；格式不可用时返回nullptr
+    static std::unique_ptr<ExportSink> create(ExportFormat format, QIODevice* device);
+
+    // 格式信息（文件对话框筛选项、默认扩展名、按扩展名推断格式）
+    static QVector<ExportFormat> availableFormats();
+    static QString displayName(ExportFormat format);
+    static QString fileSuffix(ExportFormat format);
+    static ExportFormat formatForPath(const QString& path);
+
+    // 追加一个CSV字段：含逗号/换行/双引号时加引号并把双引号转义为两个（直接写入输出缓冲，不产生临时字符串）
+    static void appendCsvField(QByteArray& out, std::string_view field);
+
+    // 写入表头/列定义
+    virtual bool begin(const QVector<ExportColumn>& columns) = 0;
+
+    // 写入一行（fields个数与begin时的列数一致）
+    virtual bool writeRow(const std::string_view* fields) = 0;
+
+    // 写出剩余缓冲并结束压缩流/写文件尾
+    virtual bool finish() = 0;
+};
+
+#endif // EXPORT_SINK_H
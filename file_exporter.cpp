@@ -1,51 +1,276 @@
 #include "file_exporter.h"
+#include "schema.h"
+#include "sqlite_reader.h"
+#include "trace.h"
+#include <QDateTime>
+#include <QFileDialog>
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
 
-bool FileExporter::exportBorrowRecords(const QString& filePath) {
-    // 校验路径
+namespace {
+
+// 导出列：表头取界面列名，整数列按声明类型判断
+template <typename Table>
+QVector<ExportColumn> tableColumns() {
+    QVector<ExportColumn> columns;
+    for (const ColumnDef& column : Table::COLUMNS) {
+        columns.append({QByteArray(column.label), QByteArray(column.decl).startsWith("INT")});
+    }
+    return columns;
+}
+
+template <typename View>
+QVector<ExportColumn> viewColumns() {
+    QVector<ExportColumn> columns;
+    for (const SelectColumnDef& column : View::COLUMNS) {
+        if (column.label) {
+            columns.append({QByteArray(column.label), column.numeric});
+        }
+    }
+    return columns;
+}
+
+} // namespace
+
+class FileExporter::RangeChannel {
+public:
+    // 放入一块：队列满时等待写出端取走；通道已取消返回false
+    bool push(RangeChunk&& chunk) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this] { return m_cancelled || int(m_chunks.size()) < MAX_QUEUED_CHUNKS; });
+        if (m_cancelled) {
+            return false;
+        }
+        m_chunks.push_back(std::move(chunk));
+        m_cond.notify_all();
+        return true;
+    }
+
+    // 生产结束（ok为false表示查询失败）
+    void finish(bool ok) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished = true;
+        m_ok = ok;
+        m_cond.notify_all();
+    }
+
+    // 取下一块：无数据且生产已结束返回false
+    bool pop(RangeChunk* chunk) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this] { return m_finished || !m_chunks.empty(); });
+        if (m_chunks.empty()) {
+            return false;
+        }
+        *chunk = std::move(m_chunks.front());
+        m_chunks.pop_front();
+        m_cond.notify_all();
+        return true;
+    }
+
+    bool succeeded() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_ok;
+    }
+
+    // 写出端放弃（出错时）：唤醒等待中的生产者使其退出，已生产的块丢弃
+    void cancel() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cancelled = true;
+        m_chunks.clear();
+        m_cond.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<RangeChunk> m_chunks;
+    bool m_finished = false;
+    bool m_ok = false;
+    bool m_cancelled = false;
+};
+
+struct FileExporter::ShardStream {
+    int shard = 0;                                        // 分片在shards()中的下标
+    QVector<ExportRange> ranges;
+    std::vector<std::unique_ptr<RangeChannel>> channels;  // 已启动的区间（保留到线程池结束）
+    int range = 0;                                        // 正在读取的区间
+    RangeChunk chunk;                                     // 正在读取的块
+    std::size_t row = 0;
+    bool failed = false;
+    QThreadPool* pool = nullptr;
+    const ReaderNameMap* readerNames = nullptr;
+    int inFlight = MIN_IN_FLIGHT_RANGES;
+
+    // 补足在生产的区间：当前区间之后最多inFlight-1个
+    void launch() {
+        while (int(channels.size()) < ranges.size() && int(channels.size()) < range + inFlight) {
+            channels.push_back(std::make_unique<RangeChannel>());
+            RangeChannel* channel = channels.back().get();
+            const ExportRange next = ranges[int(channels.size()) - 1];
+            const ReaderNameMap* names = readerNames;
+            QtConcurrent::run(pool, [next, names, channel]() { exportRange(next, names, channel); });
+        }
+    }
+
+    // 定位到下一行：当前块读完取下一块，当前区间读完转入下一区间；全部读完或出错返回false
+    bool settle() {
+        while (row >= chunk.rows.size()) {
+            if (range >= ranges.size()) {
+                return false;
+            }
+            launch();
+            RangeChannel& channel = *channels[std::size_t(range)];
+            if (channel.pop(&chunk)) {
+                row = 0;
+                continue;
+            }
+            if (!channel.succeeded()) {
+                failed = true;
+                return false;
+            }
+            chunk = RangeChunk();
+            row = 0;
+            ++range;
+        }
+        return true;
+    }
+
+    const RowSpan& current() const { return chunk.rows[row]; }
+};
+
+QString FileExporter::getSaveFileName(QWidget* parent, const QString& title, const QString& baseName,
+                                      ExportFormat* format) {
+    const QVector<ExportFormat> formats = ExportSink::availableFormats();
+    QStringList filters;
+    for (ExportFormat candidate : formats) {
+        filters << ExportSink::displayName(candidate);
+    }
+
+    // 默认文件名带日期
+    const QString defaultFileName = QString("%1_%2%3").arg(baseName, QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss"),
+                                                          ExportSink::fileSuffix(ExportFormat::Csv));
+    QString selectedFilter = filters.first();
+    QString filePath = QFileDialog::getSaveFileName(parent, title, defaultFileName, filters.join(";;"), &selectedFilter);
     if (filePath.isEmpty()) {
+        return filePath;
+    }
+
+    // 以所选筛选项为准；扩展名与格式不符时补全
+    *format = formats.value(filters.indexOf(selectedFilter), ExportSink::formatForPath(filePath));
+    const QString suffix = ExportSink::fileSuffix(*format);
+    if (!filePath.endsWith(suffix, Qt::CaseInsensitive)) {
+        filePath += suffix;
+    }
+    return filePath;
+}
+
+std::unique_ptr<ExportSink> FileExporter::openSink(QFile& file, ExportFormat format) {
+    // 校验路径
+    if (file.fileName().isEmpty()) {
         qWarning() << "导出路径为空";
-        return false;
+        return nullptr;
     }
 
-    // 打开文件（覆盖写入，UTF-8编码解决中文乱码）
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+    // 打开文件（覆盖写入，UTF-8编码解决中文乱码；文本格式按平台换行，压缩与二进制格式按原样写）
+    QIODevice::OpenMode mode = QIODevice::WriteOnly | QIODevice::Truncate;
+    if (format == ExportFormat::Csv || format == ExportFormat::JsonLines) {
+        mode |= QIODevice::Text;
+    }
+    if (!file.open(mode)) {
         qCritical() << "打开导出文件失败：" << file.errorString();
+        return nullptr;
+    }
+    std::unique_ptr<ExportSink> sink = ExportSink::create(format, &file);
+    if (!sink) {
+        file.close();
+    }
+    return sink;
+}
+
+bool FileExporter::exportBorrowRecords(const QVector<ShardInfo>& shards, const QString& filePath, ExportFormat format,
+                                       const ExportProgress& progress) {
+    TRACE_SCOPE("export", "FileExporter::exportBorrowRecords");
+    QFile file(filePath);
+    std::unique_ptr<ExportSink> sink = openSink(file, format);
+    if (!sink) {
         return false;
     }
 
-    QTextStream out(&file);
-    //out.setCodec("UTF-8"); // 强制UTF-8编码
+    // 多分馆时追加所属分馆列
+    const int shardCount = shards.size();
+    const bool multiBranch = shardCount > 1;
 
-    // 写入CSV表头（友好列名）
-    out << "借阅ID,图书编号,读者编号,读者姓名,借书时间,还书状态\n";
+    // 写入表头（由导出视图描述生成）
+    QVector<ExportColumn> columns = viewColumns<BorrowExportView>();
+    if (multiBranch) {
+        columns.append({QByteArray("所属分馆"), false});
+    }
+    if (!sink->begin(columns)) {
+        file.close();
+        return false;
+    }
 
-    // 查询借阅记录（关联读者表，补充姓名）
-    QSqlDatabase db = DatabaseManager::getInstance().getDatabase();
-    QSqlQuery query(db);
-    const QString sql = R"(
-        SELECT b.id, b.book_id, b.reader_id, r.reader_name,
-               b.borrow_time,
-               CASE WHEN b.return_time IS NULL THEN '未归还' ELSE '已归还' END
-        FROM borrow b
-        LEFT JOIN reader r ON b.reader_id = r.reader_id
-        ORDER BY b.borrow_time DESC
-    )";
-
-    if (!query.exec(sql)) {
+    // 各分馆分片按借书时间切分区间，区间在专用线程池上并行查询并解码（逾期状态由查询按应还时间判断）
+    // 写出端按键序逐块消费：每个分片只有当前区间及其后少数区间在生产，每个区间最多积压几块，
+    // 内存占用与导出总量无关；前面的区间写完再启动后面的区间
+    const int threads = qMax(1, QThread::idealThreadCount());
+    const int maxPartitions = threads;
+
+    // 各分片分摊核数：单分片时所有区间同时生产，分片多于核数时每片至少保留MIN_IN_FLIGHT_RANGES个
+    const int inFlight = qMax(MIN_IN_FLIGHT_RANGES, (threads + shardCount - 1) / qMax(1, shardCount));
+
+    // 跨馆借阅的读者登记在其他分片：先读出各分馆的读者姓名，供各区间补全
+    ReaderNameMap readerNames;
+    if (multiBranch && !loadReaderNames(shards, &readerNames)) {
         file.close();
-        qCritical() << "查询借阅记录失败：" << query.lastError().text();
         return false;
     }
 
-    // 写入数据行（转义特殊字符）
-    while (query.next()) {
-        out << query.value(0).toInt() << ","
-            << escapeCsvString(query.value(1).toString()) << ","
-            << escapeCsvString(query.value(2).toString()) << ","
-            << escapeCsvString(query.value(3).toString()) << ","
-            << escapeCsvString(query.value(4).toString()) << ","
-            << escapeCsvString(query.value(5).toString()) << "\n";
+    // 线程数等于同时在生产的区间数：被背压阻塞的区间不会占住后续区间所需的线程
+    QThreadPool pool;
+    pool.setMaxThreadCount(shardCount * inFlight);
+
+    std::vector<ShardStream> streams(std::size_t(shardCount));
+    qint64 estimatedRows = 0;
+    for (int i = 0; i < shardCount; ++i) {
+        const ShardInfo& shard = shards[i];
+        ShardStream& stream = streams[std::size_t(i)];
+        stream.shard = i;
+        stream.pool = &pool;
+        stream.readerNames = multiBranch ? &readerNames : nullptr;
+        stream.inFlight = inFlight;
+        qint64 shardRows = 0;
+        if (!planShardRanges(shard, maxPartitions, &stream.ranges, &shardRows)) {
+            file.close();
+            qCritical() << "划分导出区间失败：" << shard.branch;
+            return false;
+        }
+        estimatedRows += shardRows;
+    }
+    for (ShardStream& stream : streams) {
+        stream.launch(); // 各分片首批区间先行启动，与写出重叠
+    }
+    const bool written = writeMerged(*sink, streams, shards, multiBranch, estimatedRows, progress) && sink->finish();
+    for (ShardStream& stream : streams) {
+        for (const std::unique_ptr<RangeChannel>& channel : stream.channels) {
+            channel->cancel();
+        }
+    }
+    pool.waitForDone();
+
+    if (!written) {
+        file.close();
+        qCritical() << "导出借阅记录失败：" << file.errorString();
+        return false;
     }
 
     // 关闭文件
@@ -53,12 +278,339 @@ bool FileExporter::exportBorrowRecords(const QString& filePath) {
     return true;
 }
 
-QString FileExporter::escapeCsvString(const QString& str) {
-    // 处理CSV特殊字符：逗号、双引号、换行
-    QString result = str;
-    result.replace("\"", "\"\""); // 双引号转义为两个
-    if (result.contains(",") || result.contains("\n") || result.contains("\"")) {
-        result = "\"" + result + "\""; // 包含特殊字符则包裹双引号
+bool FileExporter::exportBooks(const QString& filePath, ExportFormat format) {
+    TRACE_SCOPE("export", "FileExporter::exportBooks");
+    return exportTable<BookTable>(filePath, format);
+}
+
+bool FileExporter::exportReaders(const QString& filePath, ExportFormat format) {
+    TRACE_SCOPE("export", "FileExporter::exportReaders");
+    return exportTable<ReaderTable>(filePath, format);
+}
+
+template <typename Table>
+bool FileExporter::exportTable(const QString& filePath, ExportFormat format) {
+    QFile file(filePath);
+    std::unique_ptr<ExportSink> sink = openSink(file, format);
+    if (!sink) {
+        return false;
+    }
+
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    const bool multiBranch = dbManager.shardCount() > 1;
+    QVector<ExportColumn> columns = tableColumns<Table>();
+    if (multiBranch) {
+        columns.append({QByteArray("所属分馆"), false});
+    }
+    if (!sink->begin(columns)) {
+        file.close();
+        return false;
+    }
+
+    const QByteArray sql = QString("SELECT %1 FROM %2 ORDER BY %3")
+                               .arg(columnListSql<Table>(), Table::NAME, Table::COLUMNS[0].name).toUtf8();
+    std::string_view fields[Table::ColumnCount + 1];
+    for (const ShardInfo& shard : dbManager.shards()) {
+        // 独立只读连接+读快照：字段按列序号解码为UTF-8视图交给接收端
+        SqliteConnection conn;
+        if (!conn.open(shard.filePath) || !conn.beginSnapshot()) {
+            qCritical() << "打开只读连接失败：" << shard.branch << conn.errorMessage();
+            file.close();
+            return false;
+        }
+        const QByteArray branch = shard.branch.toUtf8();
+        fields[Table::ColumnCount] = std::string_view(branch.constData(), std::size_t(branch.size()));
+
+        SqliteStatement stmt(conn, sql.constData());
+        bool written = true;
+        while (written && stmt.step()) {
+            for (int i = 0; i < Table::ColumnCount; ++i) {
+                fields[i] = stmt.column<std::string_view>(i);
+            }
+            written = sink->writeRow(fields);
+        }
+        if (!written || stmt.failed()) {
+            qCritical() << "导出失败：" << Table::NAME << shard.branch << conn.errorMessage();
+            file.close();
+            return false;
+        }
+    }
+
+    if (!sink->finish()) {
+        file.close();
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+bool FileExporter::planShardRanges(const ShardInfo& shard, int maxPartitions, QVector<ExportRange>* ranges,
+                                   qint64* estimatedRows) {
+    TRACE_SCOPE("export", "FileExporter::planShardRanges");
+    ranges->clear();
+    *estimatedRows = 0;
+
+    SqliteConnection conn;
+    if (!conn.open(shard.filePath) || !conn.beginSnapshot()) {
+        qCritical() << "打开只读连接失败：" << shard.branch << conn.errorMessage();
+        return false;
+    }
+
+    // 行数按ID范围估计（只读主键两端，不计数；ID有空洞时偏大，只影响区间大小和进度）
+    std::int64_t minId = 0;
+    std::int64_t maxId = -1;
+    {
+        SqliteStatement stmt(conn, "SELECT IFNULL(MIN(id), 0), IFNULL(MAX(id), -1) FROM borrow");
+        if (!stmt.step()) {
+            qCritical() << "读取借阅ID范围失败：" << conn.errorMessage();
+            return false;
+        }
+        minId = stmt.column<std::int64_t>(0);
+        maxId = stmt.column<std::int64_t>(1);
+    }
+    const std::int64_t span = maxId - minId + 1;
+    *estimatedRows = qMax<std::int64_t>(0, span);
+
+    int partitions = int(qBound<std::int64_t>(1, span / MIN_ROWS_PER_PARTITION, maxPartitions));
+    ExportRange range;
+    range.shard = shard;
+    if (partitions == 1) {
+        range.includeNullTime = true;
+        ranges->append(range);
+        return true;
+    }
+
+    // ID范围内等距取样，每个样本一次主键定位；样本按导出顺序（借书时间、ID倒序）排序后取分位点作边界
+    std::vector<std::pair<QByteArray, std::int64_t>> samples;
+    const int sampleCount = partitions * SAMPLES_PER_PARTITION;
+    samples.reserve(std::size_t(sampleCount));
+    SqliteStatement stmt(conn, "SELECT borrow_time, id FROM borrow WHERE id >= ? AND borrow_time IS NOT NULL "
+                               "ORDER BY id LIMIT 1");
+    for (int i = 0; i < sampleCount; ++i) {
+        stmt.reset();
+        stmt.bind(1, std::int64_t(minId + span * i / sampleCount));
+        if (stmt.step()) {
+            const std::string_view time = stmt.column<std::string_view>(0);
+            samples.emplace_back(QByteArray(time.data(), int(time.size())), stmt.column<std::int64_t>(1));
+        } else if (stmt.failed()) {
+            qCritical() << "划分导出区间失败：" << conn.errorMessage();
+            return false;
+        }
+    }
+    std::sort(samples.begin(), samples.end(), std::greater<>());
+    samples.erase(std::unique(samples.begin(), samples.end()), samples.end()); // ID空洞处可能取到同一行
+    partitions = qMin(partitions, int(samples.size()));
+
+    for (int i = 1; i < partitions; ++i) {
+        // 边界样本是本区间最后一行：作为本区间的下界（含）和下一区间的上界（不含）
+        const std::size_t last = samples.size() * std::size_t(i) / std::size_t(partitions) - 1;
+        const std::pair<QByteArray, std::int64_t>& boundary = samples[last];
+        ExportRange current = range;
+        current.hasLower = true;
+        current.lowerTime = boundary.first;
+        current.lowerId = boundary.second;
+        ranges->append(current);
+
+        range.hasUpper = true;
+        range.upperTime = current.lowerTime;
+        range.upperId = current.lowerId;
+    }
+    // 末区间无下界，并收纳借书时间为空的行
+    range.includeNullTime = true;
+    ranges->append(range);
+    return true;
+}
+
+bool FileExporter::loadReaderNames(const QVector<ShardInfo>& shards, ReaderNameMap* names) {
+    TRACE_SCOPE("export", "FileExporter::loadReaderNames");
+    names->clear();
+    for (const ShardInfo& shard : shards) {
+        SqliteConnection conn;
+        if (!conn.open(shard.filePath)) {
+            qCritical() << "打开只读连接失败：" << shard.branch << conn.errorMessage();
+            return false;
+        }
+        SqliteStatement stmt(conn, "SELECT reader_id, reader_name FROM reader");
+        while (stmt.step()) {
+            const std::string_view readerId = stmt.column<std::string_view>(0);
+            const std::string_view readerName = stmt.column<std::string_view>(1);
+            names->insert(QByteArray(readerId.data(), int(readerId.size())),
+                          QByteArray(readerName.data(), int(readerName.size())));
+        }
+        if (stmt.failed()) {
+            qCritical() << "读取读者姓名失败：" << shard.branch << conn.errorMessage();
+            return false;
+        }
+    }
+    return true;
+}
+
+void FileExporter::exportRange(const ExportRange& range, const ReaderNameMap* readerNames, RangeChannel* channel) {
+    TRACE_SCOPE("export", "FileExporter::exportRange");
+
+    // 每个区间独立的只读连接+读快照，逐行解码为基本类型后把字段依次存入块缓冲，攒满一块交给写出端
+    // （各区间快照可能相差几个提交：区间按键互不重叠，借还并发时不会重复或遗漏已有记录）
+    SqliteConnection conn;
+    if (!conn.open(range.shard.filePath) || !conn.beginSnapshot()) {
+        qCritical() << "打开只读连接失败：" << range.shard.branch << conn.errorMessage();
+        channel->finish(false);
+        return;
+    }
+
+    QStringList conditions;
+    if (range.hasUpper) {
+        conditions << "(b.borrow_time, b.id) < (?, ?)";
+    }
+    if (range.hasLower) {
+        conditions << "(b.borrow_time, b.id) >= (?, ?)";
+    }
+    QString where = conditions.isEmpty() ? QString("1") : conditions.join(" AND ");
+    if (range.includeNullTime && !conditions.isEmpty()) {
+        where = QString("(%1) OR b.borrow_time IS NULL").arg(where);
+    }
+    // 查询借阅记录（关联本分片读者表补充姓名，读者登记在其他分馆时为NULL，稍后按姓名表补全）
+    // 查询借阅记录（关联读者表，补充姓名）
+    const QByteArray sql = QString("SELECT %1 FROM borrow b LEFT JOIN reader r ON b.reader_id = r.reader_id "
+                                   "WHERE %2 ORDER BY b.borrow_time DESC, b.id DESC")
+                               .arg(selectListSql<BorrowExportView>(), where).toUtf8();
+    SqliteStatement stmt(conn, sql.constData());
+    int param = 1;
+    if (range.hasUpper) {
+        stmt.bind(param++, std::string_view(range.upperTime.constData(), std::size_t(range.upperTime.size())));
+        stmt.bind(param++, range.upperId);
+    }
+    if (range.hasLower) {
+        stmt.bind(param++, std::string_view(range.lowerTime.constData(), std::size_t(range.lowerTime.size())));
+        stmt.bind(param++, range.lowerId);
     }
-    return result;
+    if (!stmt.isValid()) {
+        qCritical() << "查询借阅记录失败：" << range.shard.branch << conn.errorMessage();
+        channel->finish(false);
+        return;
+    }
+
+    RangeChunk chunk;
+    chunk.data.reserve(CHUNK_BYTES + CHUNK_BYTES / 8);
+    BorrowExportRecord record;
+    char idText[24];
+    auto appendCell = [&chunk](std::string_view field) {
+        if (!field.data()) {
+            chunk.cells.push_back({std::int64_t(chunk.data.size()), -1});
+            return;
+        }
+        chunk.cells.push_back({std::int64_t(chunk.data.size()), std::int64_t(field.size())});
+        chunk.data.append(field.data(), int(field.size()));
+    };
+    while (stmt.step()) {
+        stmt.decode(record);
+        chunk.rows.push_back({record.borrowEpoch, record.id, chunk.cells.size()});
+
+        const int idLength = std::snprintf(idText, sizeof(idText), "%lld", static_cast<long long>(record.id));
+        appendCell(std::string_view(idText, std::size_t(idLength)));
+        appendCell(record.bookId);
+        appendCell(record.readerId);
+        if (!record.readerName.data() && readerNames) {
+            // 读者登记在其他分馆
+            const auto it = readerNames->constFind(
+                QByteArray::fromRawData(record.readerId.data(), int(record.readerId.size())));
+            appendCell(it != readerNames->cend() ? std::string_view(it->constData(), std::size_t(it->size()))
+                                                 : std::string_view());
+        } else {
+            appendCell(record.readerName);
+        }
+        appendCell(record.borrowTime);
+        // 还书状态：未归还且已过应还时间的记录标记为已逾期
+        if (!record.unreturned) {
+            appendCell("已归还");
+        } else if (record.overdue) {
+            appendCell("已逾期");
+        } else {
+            appendCell("未归还");
+        }
+
+        // 块满即交出（写出端未跟上时在此等待）；写出端已放弃则停止查询
+        if (chunk.data.size() >= CHUNK_BYTES) {
+            if (!channel->push(std::move(chunk))) {
+                return;
+            }
+            chunk = RangeChunk();
+            chunk.data.reserve(CHUNK_BYTES + CHUNK_BYTES / 8);
+        }
+    }
+    if (stmt.failed()) {
+        qCritical() << "读取借阅记录失败：" << range.shard.branch << conn.errorMessage();
+        channel->finish(false);
+        return;
+    }
+    if (!chunk.rows.empty() && !channel->push(std::move(chunk))) {
+        return;
+    }
+    channel->finish(true);
+}
+
+bool FileExporter::writeMerged(ExportSink& sink, std::vector<ShardStream>& streams, const QVector<ShardInfo>& shards,
+                               bool withBranch, qint64 estimatedRows, const ExportProgress& progress) {
+    TRACE_SCOPE("export", "FileExporter::writeMerged");
+    QVector<QByteArray> branches;
+    for (const ShardInfo& shard : shards) {
+        branches.append(shard.branch.toUtf8());
+    }
+
+    // 还原一行字段视图（分馆列取自分片信息，不在块缓冲中重复存储）
+    std::string_view fields[BORROW_FIELD_COUNT + 1];
+    auto writeRow = [&](const ShardStream& stream) {
+        const RangeChunk& chunk = stream.chunk;
+        const std::size_t firstCell = stream.current().firstCell;
+        for (int i = 0; i < BORROW_FIELD_COUNT; ++i) {
+            const CellSpan& cell = chunk.cells[firstCell + std::size_t(i)];
+            fields[i] = cell.length < 0 ? std::string_view()
+                                        : std::string_view(chunk.data.constData() + cell.offset, std::size_t(cell.length));
+        }
+        if (withBranch) {
+            const QByteArray& branch = branches[stream.shard];
+            fields[BORROW_FIELD_COUNT] = std::string_view(branch.constData(), std::size_t(branch.size()));
+        }
+        return sink.writeRow(fields);
+    };
+
+    // 每个分片的区间拼接成一条有序序列，再按(借书时间, 借阅ID)倒序多路归并（单分片时堆中只有一项）
+    auto after = [&streams](int a, int b) {
+        const RowSpan& ra = streams[std::size_t(a)].current();
+        const RowSpan& rb = streams[std::size_t(b)].current();
+        return ra.borrowEpoch != rb.borrowEpoch ? ra.borrowEpoch < rb.borrowEpoch : ra.id < rb.id;
+    };
+    std::priority_queue<int, std::vector<int>, decltype(after)> heap(after);
+    for (std::size_t i = 0; i < streams.size(); ++i) {
+        if (streams[i].settle()) {
+            heap.push(int(i));
+        } else if (streams[i].failed) {
+            return false;
+        }
+    }
+
+    qint64 written = 0;
+    while (!heap.empty()) {
+        const int index = heap.top();
+        heap.pop();
+        ShardStream& stream = streams[std::size_t(index)];
+        if (!writeRow(stream)) {
+            return false;
+        }
+        ++stream.row;
+        if (stream.settle()) {
+            heap.push(index);
+        } else if (stream.failed) {
+            qCritical() << "查询借阅记录失败：" << shards[stream.shard].branch;
+            return false;
+        }
+        ++written;
+        if (progress && written % PROGRESS_INTERVAL_ROWS == 0 && !progress(written, qMax(written, estimatedRows))) {
+            qWarning() << "导出已中止";
+            return false;
+        }
+    }
+    if (progress) {
+        progress(written, written);
+    }
+    return true;
 }
@@ -2,25 +2,109 @@
 #define FILE_EXPORTER_H
 
 #include <QString>
+#include <QByteArray>
 #include <QFile>
-#include <QTextStream>
+#include <QHash>
 #include <QMessageBox>
-#include <QSqlQuery>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
 #include "database_manager.h"
+#include "export_sink.h"
+#include "schema.h"
 
-// 静态工具类：负责数据导出（仅CSV，可扩展）
+// 静态工具类：负责数据导出（CSV/压缩CSV/JSON Lines/列式二进制，由ExportSink编码）
 class FileExporter {
 public:
-    // 导出借阅记录为CSV（含表头+格式化数据）
-    static bool exportBorrowRecords(const QString& filePath);
+    // 导出进度回调（在执行导出的线程上调用）：已写出行数、估计总行数；返回false则中止导出
+    using ExportProgress = std::function<bool(qint64 written, qint64 total)>;
+
+    // 导出借阅记录（按借书时间倒序；区间按块流式交给接收端，内存占用与导出总量无关）
+    // 只用自建连接和传入的分片信息，可在工作线程上执行
+    static bool exportBorrowRecords(const QVector<ShardInfo>& shards, const QString& filePath,
+                                    ExportFormat format = ExportFormat::Csv,
+                                    const ExportProgress& progress = ExportProgress());
+
+    // 导出图书/读者（各分馆依次按编号排序输出）
+    static bool exportBooks(const QString& filePath, ExportFormat format = ExportFormat::Csv);
+    static bool exportReaders(const QString& filePath, ExportFormat format = ExportFormat::Csv);
+
+    // 弹出保存对话框选择路径与格式（按所选格式补全扩展名），取消时返回空串
+    static QString getSaveFileName(QWidget* parent, const QString& title, const QString& baseName,
+                                   ExportFormat* format);
 
 private:
     // 私有构造：禁止实例化
     FileExporter() = default;
     ~FileExporter() = default;
 
-    // 辅助：转义CSV特殊字符（逗号/换行）
-    static QString escapeCsvString(const QString& str);
+    // 打开导出文件并创建对应格式的接收端
+    static std::unique_ptr<ExportSink> openSink(QFile& file, ExportFormat format);
+
+    // 图书/读者等单表导出：逐分片在读快照内按主键顺序扫描，直接流式写入接收端
+    template <typename Table>
+    static bool exportTable(const QString& filePath, ExportFormat format);
+
+    // 导出区间：按(借书时间, 借阅ID)倒序切分，区间互不重叠，按序拼接即为整体顺序
+    struct ExportRange {
+        ShardInfo shard;
+        bool hasUpper = false;      // 上界（不含）：键 < (upperTime, upperId)
+        QByteArray upperTime;
+        std::int64_t upperId = 0;
+        bool hasLower = false;      // 下界（含）：键 >= (lowerTime, lowerId)
+        QByteArray lowerTime;
+        std::int64_t lowerId = 0;
+        bool includeNullTime = false; // 借书时间为空的行排在最后，归入末区间
+    };
+
+    // 区间导出的一块结果：各行字段存于同一缓冲（不经任何格式编码），附排序键供跨分片归并
+    struct CellSpan {
+        std::int64_t offset;
+        std::int64_t length; // -1表示NULL
+    };
+    struct RowSpan {
+        std::int64_t borrowEpoch;
+        std::int64_t id;
+        std::size_t firstCell;
+    };
+    struct RangeChunk {
+        QByteArray data;
+        std::vector<CellSpan> cells;
+        std::vector<RowSpan> rows;
+    };
+
+    // 各分馆读者的姓名（编号 -> 姓名，UTF-8）：借阅的读者登记在其他分馆时，本分片的读者表查不到姓名
+    using ReaderNameMap = QHash<QByteArray, QByteArray>;
+
+    // 区间到写出端的有界通道：工作线程逐块放入，队列满时等待写出端取走（背压）
+    class RangeChannel;
+
+    // 单个分片的输出流：区间按序读取，只有当前区间及其后若干区间在生产（窗口按核数与分片数确定）
+    struct ShardStream;
+
+    // 在借阅ID范围内等距取样（每个样本一次主键定位），按样本分位点切分区间边界；estimatedRows返回估计行数
+    static bool planShardRanges(const ShardInfo& shard, int maxPartitions, QVector<ExportRange>* ranges,
+                                qint64* estimatedRows);
+
+    // 读出所有分片的读者姓名（多分馆导出前调用，导出期间工作线程只读）
+    static bool loadReaderNames(const QVector<ShardInfo>& shards, ReaderNameMap* names);
+
+    // 在工作线程上查询一个区间，按块送入通道（通道被取消时提前结束）；本分片读者表查不到的姓名从readerNames补全
+    static void exportRange(const ExportRange& range, const ReaderNameMap* readerNames, RangeChannel* channel);
+
+    // 同一分片的区间按序拼接；多分片时再按借书时间倒序多路归并，逐行交给接收端
+    static bool writeMerged(ExportSink& sink, std::vector<ShardStream>& streams, const QVector<ShardInfo>& shards,
+                            bool withBranch, qint64 estimatedRows, const ExportProgress& progress);
+
+    static constexpr int MIN_ROWS_PER_PARTITION = 20000; // 区间过小时并行收益不抵开销
+    static constexpr int MIN_IN_FLIGHT_RANGES = 2;       // 每个分片同时在生产的区间数下限（分片多于核数时）
+    static constexpr int SAMPLES_PER_PARTITION = 32;     // 划分区间时每个区间的取样数
+    static constexpr int PROGRESS_INTERVAL_ROWS = 65536; // 每写出这么多行回报一次进度
+    static constexpr int CHUNK_BYTES = 1024 * 1024;      // 每块字段缓冲的目标大小
+    static constexpr int MAX_QUEUED_CHUNKS = 4;          // 每个区间已生产未写出的块数上限
+    static constexpr int BORROW_FIELD_COUNT = BorrowExportView::ColumnCount - 2; // 末两列为排序键和逾期标记，不导出
 };
 
 #endif // FILE_EXPORTER_H
@@ -0,0 +1,206 @@
+#include "hold_queue.h"
+#include "database_manager.h"
+#include "schema.h"
+#include "sqlite_reader.h"
+#include "trace.h"
+#include <QFile>
+#include <QSet>
+
+HoldQueue::HoldQueue()
+{
+    // 留书期限以天计，分钟级清理足够及时
+    m_sweepTimer.setInterval(SWEEP_INTERVAL_MS);
+    m_sweepTimer.setTimerType(Qt::VeryCoarseTimer);
+    connect(&m_sweepTimer, &QTimer::timeout, this, &HoldQueue::onSweep);
+}
+
+bool HoldQueue::start() {
+    TRACE_SCOPE("db", "HoldQueue::start");
+    bool allLoaded = true;
+    for (const ShardInfo& shard : DatabaseManager::getInstance().shards()) {
+        if (!loadShard(shard.index)) {
+            allLoaded = false;
+        }
+    }
+
+    // 停机期间到期的留书立即处理
+    onSweep();
+    m_sweepTimer.start();
+    return allLoaded;
+}
+
+void HoldQueue::stop() {
+    m_sweepTimer.stop();
+}
+
+void HoldQueue::add(int shard, const QString& bookId, const Waiter& waiter) {
+    remove(shard, waiter.reservationId);
+    m_queues[BookKey(shard, bookId)].insert(waiter);
+    m_entries.insert(EntryKey(shard, waiter.reservationId), {bookId, waiter});
+}
+
+void HoldQueue::remove(int shard, int reservationId) {
+    const auto entry = m_entries.find(EntryKey(shard, reservationId));
+    if (entry == m_entries.end()) {
+        return;
+    }
+    const auto queue = m_queues.find(BookKey(shard, entry->bookId));
+    if (queue != m_queues.end()) {
+        queue->erase(entry->waiter);
+        if (queue->empty()) {
+            m_queues.erase(queue);
+        }
+    }
+    m_entries.erase(entry);
+}
+
+bool HoldQueue::peek(int shard, const QString& bookId, Waiter* waiter) {
+    if (!syncShard(shard)) {
+        qWarning() << "同步预约队列失败，按本机已知的预约分配：" << DatabaseManager::getInstance().branchName(shard);
+    }
+    const auto queue = m_queues.constFind(BookKey(shard, bookId));
+    if (queue == m_queues.constEnd() || queue->empty()) {
+        return false;
+    }
+    *waiter = *queue->begin();
+    return true;
+}
+
+int HoldQueue::waitingCount(int shard, const QString& bookId) const {
+    const auto queue = m_queues.constFind(BookKey(shard, bookId));
+    return queue == m_queues.constEnd() ? 0 : int(queue->size());
+}
+
+bool HoldQueue::loadShard(int shard) {
+    TRACE_SCOPE("db", "HoldQueue::loadShard");
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    QString filePath;
+    for (const ShardInfo& info : dbManager.shards()) {
+        if (info.index == shard) {
+            filePath = info.filePath;
+        }
+    }
+    if (filePath.isEmpty()) {
+        return false;
+    }
+
+    // 先取data_version再开读快照：两者之间的提交会在下次同步时再读一遍，不会漏掉
+    const qint64 version = dbManager.dataVersion(shard);
+    SqliteConnection conn;
+    if (!conn.open(filePath) || !conn.beginSnapshot()) {
+        qCritical() << "打开只读连接失败：" << conn.errorMessage();
+        return false;
+    }
+
+    // 游标与等待中的预约取自同一快照
+    SqliteStatement seqStmt(conn, "SELECT IFNULL(MAX(seq), 0) FROM change_log");
+    if (!seqStmt.step()) {
+        qCritical() << "读取变更日志失败：" << conn.errorMessage();
+        return false;
+    }
+    const qint64 cursor = seqStmt.column<std::int64_t>(0);
+
+    dropShard(shard);
+    SqliteStatement stmt(conn, "SELECT id, book_id, reader_id, priority FROM reservation WHERE status = 'W'");
+    ReservationWaitRecord record;
+    while (stmt.step()) {
+        stmt.decode(record);
+        add(shard, QString::fromUtf8(record.bookId.data(), int(record.bookId.size())),
+            {int(record.id), int(record.priority),
+             QString::fromUtf8(record.readerId.data(), int(record.readerId.size()))});
+    }
+    if (stmt.failed()) {
+        qCritical() << "加载预约队列失败：" << conn.errorMessage();
+        dropShard(shard);
+        return false;
+    }
+
+    ShardState state;
+    state.dataVersion = version;
+    state.cursor = cursor;
+    m_shards.insert(shard, state);
+    return true;
+}
+
+bool HoldQueue::syncShard(int shard) {
+    const auto state = m_shards.constFind(shard);
+    if (state == m_shards.constEnd()) {
+        return loadShard(shard);
+    }
+
+    // data_version未变说明没有任何新提交，无需查变更日志
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    const qint64 version = dbManager.dataVersion(shard);
+    if (version < 0) {
+        return false;
+    }
+    if (version == state->dataVersion) {
+        return true;
+    }
+
+    TRACE_SCOPE("db", "HoldQueue::syncShard");
+    const qint64 cursor = state->cursor;
+    QVector<DatabaseManager::ChangeEntry> entries;
+    qint64 oldestSeq = 0;
+    if (!dbManager.readChanges(shard, ReservationTable::NAME, cursor, MAX_SYNC_BATCH + 1, &entries, &oldestSeq)) {
+        return false;
+    }
+    // 游标之后的日志已被清理，或变更过多：整片重新加载
+    if (oldestSeq > cursor + 1 || entries.size() > MAX_SYNC_BATCH) {
+        return loadShard(shard);
+    }
+
+    QSet<int> seen;
+    for (const DatabaseManager::ChangeEntry& entry : entries) {
+        const int reservationId = entry.rowKey.toInt();
+        if (!seen.contains(reservationId)) {
+            seen.insert(reservationId);
+            reloadReservation(shard, reservationId);
+        }
+    }
+    ShardState& updated = m_shards[shard];
+    updated.dataVersion = version;
+    if (!entries.isEmpty()) {
+        updated.cursor = entries.last().seq;
+    }
+    return true;
+}
+
+void HoldQueue::reloadReservation(int shard, int reservationId) {
+    // 按主键重读一行：仍在等待则（重新）入队，否则出队
+    QSqlQuery query(DatabaseManager::getInstance().getReadDatabase(shard));
+    query.prepare("SELECT book_id, reader_id, priority, status FROM reservation WHERE id = ?");
+    query.addBindValue(reservationId);
+    if (!query.exec()) {
+        qWarning() << "读取预约失败：" << query.lastError().text();
+        return;
+    }
+    remove(shard, reservationId);
+    if (query.next() && query.value(3).toString() == "W") {
+        add(shard, query.value(0).toString(), {reservationId, query.value(2).toInt(), query.value(1).toString()});
+    }
+}
+
+void HoldQueue::dropShard(int shard) {
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it.key().first == shard) {
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = m_queues.begin(); it != m_queues.end();) {
+        if (it.key().first == shard) {
+            it = m_queues.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_shards.remove(shard);
+}
+
+void HoldQueue::onSweep() {
+    if (DatabaseManager::getInstance().expireHolds() > 0) {
+        emit holdsChanged();
+    }
+}
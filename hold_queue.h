@@ -0,0 +1,96 @@
+#ifndef HOLD_QUEUE_H
+#define HOLD_QUEUE_H
+
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QTimer>
+#include <set>
+
+// 预约队列单例：每本书一个按（优先级降序、预约ID升序）排列的有序集合，队首即下一位留书读者
+// 登记、取消、取队首均为O(log n)，还书分配副本时按队首的预约ID更新，不扫描预约表
+// 其他终端的登记/取消经变更日志增量同步；取队首前先同步，在写事务内调用时与库中状态一致
+class HoldQueue : public QObject {
+    Q_OBJECT
+
+public:
+    static HoldQueue& getInstance() {
+        static HoldQueue instance;
+        return instance;
+    }
+
+    HoldQueue(const HoldQueue&) = delete;
+    HoldQueue& operator=(const HoldQueue&) = delete;
+
+    // 等待中的预约
+    struct Waiter {
+        int reservationId;
+        int priority;
+        QString readerId;
+    };
+
+    // 加载所有分片的等待中预约并启动过期留书清理（程序启动时执行；加载失败的分片在首次取队首时重试）
+    bool start();
+
+    // 停止过期清理（程序退出前调用）
+    void stop();
+
+    // 登记/移除等待中的预约（本进程事务提交后调用）
+    void add(int shard, const QString& bookId, const Waiter& waiter);
+    void remove(int shard, int reservationId);
+
+    // 同步变更后取队首（不出队：分配事务提交后再remove），无人等待返回false
+    bool peek(int shard, const QString& bookId, Waiter* waiter);
+
+    // 某本书的等待人数
+    int waitingCount(int shard, const QString& bookId) const;
+
+signals:
+    // 过期清理改变了留书状态
+    void holdsChanged();
+
+private slots:
+    void onSweep();
+
+private:
+    HoldQueue();
+    ~HoldQueue() override = default;
+
+    // 优先级高者在前，同优先级先登记者在前（预约ID自增）
+    struct WaiterOrder {
+        bool operator()(const Waiter& a, const Waiter& b) const {
+            return a.priority != b.priority ? a.priority > b.priority : a.reservationId < b.reservationId;
+        }
+    };
+    using Queue = std::set<Waiter, WaiterOrder>;
+    using BookKey = QPair<int, QString>;  // (分片, 图书编号)
+    using EntryKey = QPair<int, int>;     // (分片, 预约ID)
+
+    // 预约ID索引：移除时据此定位所在集合
+    struct Entry {
+        QString bookId;
+        Waiter waiter;
+    };
+
+    struct ShardState {
+        qint64 dataVersion = -1;
+        qint64 cursor = 0;
+    };
+
+    // 整片重新加载 / 按变更日志增量同步
+    bool loadShard(int shard);
+    bool syncShard(int shard);
+    void reloadReservation(int shard, int reservationId);
+    void dropShard(int shard);
+
+    QHash<BookKey, Queue> m_queues;
+    QHash<EntryKey, Entry> m_entries;
+    QHash<int, ShardState> m_shards;     // 已加载的分片
+    QTimer m_sweepTimer;
+
+    static const int MAX_SYNC_BATCH = 500;          // 单次变更超过此数直接整片重新加载
+    static const int SWEEP_INTERVAL_MS = 60 * 1000; // 过期留书清理周期
+};
+
+#endif // HOLD_QUEUE_H
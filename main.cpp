@@ -1,10 +1,71 @@
 #include "mainwindow.h"
+#include "audit_log.h"
+#include "benchmark.h"
+#include "circulation_rollup.h"
+#include "storage_profile.h"
+#include "trace.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    // 基准测试命令无需界面
+    if (Benchmark::isBenchmarkCommand(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return Benchmark::run(app.arguments());
+    }
+
+    // 流通汇总：区间报表与日桶重建
+    if (CirculationRollup::isCommand(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return CirculationRollup::runCommand(app.arguments());
+    }
+
+    // 审计查询：按时间/读者/图书筛选并回放审计事件
+    if (AuditLog::isQueryCommand(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        return AuditLog::runQuery(app.arguments());
+    }
+
+    TracingApplication a(argc, argv);
+
+    // 命令行：--branch <分馆名称> 指定本馆（新增的图书/读者写入该分馆分片）
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"branch", "本馆名称（不存在时自动创建分馆分片）", "name"});
+    parser.addOption({"busy-timeout", "数据库忙等待超时（毫秒）", "ms"});
+    parser.addOption({"max-retries", "借还事务遇到写冲突时的最大尝试次数", "count"});
+    parser.addOption({"storage-profile", QString("存储配置档（%1，默认%2；可用--bench-profiles比较）")
+                                             .arg(StorageProfile::names().join(" / "),
+                                                  QLatin1String(StorageProfile::defaultProfile().name)),
+                      "name"});
+    parser.addOption({"trace", "启动即开启性能追踪（可在帮助菜单导出）"});
+    parser.process(a);
+
+    Tracer::setEnabled(parser.isSet("trace"));
+
+    DatabaseManager& dbManager = DatabaseManager::getInstance();
+    if (parser.isSet("branch")) {
+        dbManager.setCurrentBranch(parser.value("branch"));
+    }
+    if (parser.isSet("busy-timeout")) {
+        dbManager.setBusyTimeout(parser.value("busy-timeout").toInt());
+    }
+    if (parser.isSet("storage-profile")) {
+        const StorageProfile* profile = StorageProfile::find(parser.value("storage-profile"));
+        if (profile) {
+            dbManager.setStorageProfile(*profile);
+        } else {
+            qWarning() << "未知的存储配置档，使用默认配置：" << parser.value("storage-profile");
+        }
+    }
+    if (parser.isSet("max-retries")) {
+        DatabaseManager::RetryPolicy policy;
+        policy.maxAttempts = qMax(1, parser.value("max-retries").toInt());
+        dbManager.setRetryPolicy(policy);
+    }
+
     MainWindow w;
     w.show();
     return a.exec();
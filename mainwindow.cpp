@@ -1,9 +1,19 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "audit_log.h"
+#include "circulation_report_dialog.h"
+#include "file_exporter.h"
+#include "hold_queue.h"
+#include "overdue_scheduler.h"
+#include "trace.h"
 #include <QMessageBox>
 #include <QMenu>
 #include <QAction>
 #include <QStatusBar>
+#include <QTimer>
+#include <QFileDialog>
+#include <QDateTime>
+#include <QtConcurrent>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -20,6 +30,28 @@ MainWindow::MainWindow(QWidget *parent) :
         return;
     }
 
+    // 启动审计日志写线程（借还与增删改在提交后入队，后台攒批落盘）
+    if (!AuditLog::getInstance().start(DatabaseManager::getInstance().auditLogDirectory())) {
+        this->statusBar()->showMessage("审计日志启动失败，本次修改不会留下审计记录", 5000);
+    }
+
+    // 启动逾期调度（加载未归还借阅的应还时间）
+    if (!OverdueScheduler::getInstance().start()) {
+        this->statusBar()->showMessage("逾期调度器启动失败，逾期提醒不可用", 5000);
+    }
+
+    // 加载预约队列并定时清理过期留书（加载失败的分片在首次还书时重试）
+    if (!HoldQueue::getInstance().start()) {
+        this->statusBar()->showMessage("预约队列加载失败，将在还书时重试", 5000);
+    }
+
+    // 定时执行WAL检查点，避免长时间读取期间WAL无限增长
+    QTimer* checkpointTimer = new QTimer(this);
+    connect(checkpointTimer, &QTimer::timeout, this, []() {
+        DatabaseManager::getInstance().runScheduledCheckpoint();
+    });
+    checkpointTimer->start(CHECKPOINT_INTERVAL_MS);
+
     // 初始化子面板
     m_bookPanel = new BookPanel(this);
     m_readerPanel = new ReaderPanel(this);
@@ -34,7 +66,9 @@ MainWindow::MainWindow(QWidget *parent) :
     initMenuBar();
 
     // 初始化状态栏
-    this->statusBar()->showMessage("就绪 - 当前用户：管理员", 3000);
+    const DatabaseManager& dbManager = DatabaseManager::getInstance();
+    const QString branch = dbManager.branchName(dbManager.currentShard());
+    this->statusBar()->showMessage(QString("就绪 - 当前用户：管理员 - 本馆：%1").arg(branch), 3000);
 
     // 默认选中第一个功能
     ui->funcListWidget->setCurrentRow(0);
@@ -42,6 +76,14 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    OverdueScheduler::getInstance().stop();
+    HoldQueue::getInstance().stop();
+    // 流通汇总回填尚未写回时放弃，下次启动重新扫描
+    DatabaseManager::getInstance().waitForRollupBackfill(true);
+    // 目录有改动时重新生成快照，下次启动即可直接映射
+    DatabaseManager::getInstance().saveCatalogSnapshot();
+    // 写出尚在队列中的审计事件
+    AuditLog::getInstance().stop();
     delete ui;
     // 子面板由parent析构，无需手动删除
 }
@@ -57,6 +99,8 @@ void MainWindow::initMenuBar()
     QAction* borrowAction = new QAction("借阅管理(&L)", this);
 
     QAction* exportAction = new QAction("导出借阅记录(&E)", this);
+    QAction* exportBooksAction = new QAction("导出图书(&O)...", this);
+    QAction* exportReadersAction = new QAction("导出读者(&D)...", this);
     QAction* exitAction = new QAction("退出(&X)", this);
 
     fileMenu->addAction(bookAction);
@@ -64,12 +108,28 @@ void MainWindow::initMenuBar()
     fileMenu->addAction(borrowAction);
     fileMenu->addSeparator();
     fileMenu->addAction(exportAction);
+    fileMenu->addAction(exportBooksAction);
+    fileMenu->addAction(exportReadersAction);
     fileMenu->addSeparator();
     fileMenu->addAction(exitAction);
 
-    // 2. 帮助菜单
+    // 2. 工具菜单
+    QMenu* toolMenu = this->menuBar()->addMenu("工具(&T)");
+    m_reconcileAction = new QAction("库存核对(&C)...", this);
+    toolMenu->addAction(m_reconcileAction);
+    QAction* circulationAction = new QAction("流通统计(&R)...", this);
+    toolMenu->addAction(circulationAction);
+
+    // 3. 帮助菜单
     QMenu* helpMenu = this->menuBar()->addMenu("帮助(&H)");
+    QAction* traceAction = new QAction("开启性能追踪(&P)", this);
+    traceAction->setCheckable(true);
+    traceAction->setChecked(Tracer::isEnabled());
+    QAction* exportTraceAction = new QAction("导出性能追踪(&T)...", this);
     QAction* aboutAction = new QAction("关于(&A)", this);
+    helpMenu->addAction(traceAction);
+    helpMenu->addAction(exportTraceAction);
+    helpMenu->addSeparator();
     helpMenu->addAction(aboutAction);
 
     // 绑定菜单事件
@@ -94,12 +154,139 @@ void MainWindow::initMenuBar()
         m_borrowPanel->on_exportBorrowBtn_clicked();
     });
 
+    connect(exportBooksAction, &QAction::triggered, this, [=]() {
+        ExportFormat format = ExportFormat::Csv;
+        const QString filePath = FileExporter::getSaveFileName(this, "导出图书", "图书", &format);
+        if (filePath.isEmpty()) {
+            return;
+        }
+        if (FileExporter::exportBooks(filePath, format)) {
+            QMessageBox::information(this, "导出成功", QString("图书已导出至：\n%1").arg(filePath));
+        } else {
+            QMessageBox::critical(this, "导出失败", "无法导出图书！\n请检查文件路径是否可写。");
+        }
+    });
+
+    connect(exportReadersAction, &QAction::triggered, this, [=]() {
+        ExportFormat format = ExportFormat::Csv;
+        const QString filePath = FileExporter::getSaveFileName(this, "导出读者", "读者", &format);
+        if (filePath.isEmpty()) {
+            return;
+        }
+        if (FileExporter::exportReaders(filePath, format)) {
+            QMessageBox::information(this, "导出成功", QString("读者已导出至：\n%1").arg(filePath));
+        } else {
+            QMessageBox::critical(this, "导出失败", "无法导出读者！\n请检查文件路径是否可写。");
+        }
+    });
+
     connect(exitAction, &QAction::triggered, this, &MainWindow::close);
+    connect(traceAction, &QAction::toggled, this, [=](bool checked) {
+        Tracer::setEnabled(checked);
+        this->statusBar()->showMessage(checked ? "性能追踪已开启" : "性能追踪已关闭", 2000);
+    });
+    connect(exportTraceAction, &QAction::triggered, this, &MainWindow::exportTrace);
+    connect(m_reconcileAction, &QAction::triggered, this, [=]() {
+        reconcileStock(false);
+    });
+    connect(circulationAction, &QAction::triggered, this, [=]() {
+        CirculationReportDialog dialog(this);
+        dialog.exec();
+    });
     connect(aboutAction, &QAction::triggered, this, [=]() {
         QMessageBox::information(this, "关于", "图书与借阅管理系统\n基于Qt 5.15开发\n© 2025 课程设计");
     });
 }
 
+void MainWindow::exportTrace()
+{
+    if (Tracer::eventCount() == 0) {
+        QMessageBox::information(this, "提示", "尚无追踪数据，请先在帮助菜单开启性能追踪并进行操作。");
+        return;
+    }
+
+    const QString defaultFileName = QString("trace_%1.json").arg(QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss"));
+    const QString filePath = QFileDialog::getSaveFileName(this, "导出性能追踪", defaultFileName,
+                                                          "Chrome Trace (*.json);;所有文件 (*.*)");
+    if (filePath.isEmpty()) {
+        return;
+    }
+
+    if (Tracer::writeChromeTrace(filePath)) {
+        QMessageBox::information(this, "导出成功",
+                                 QString("追踪已导出至：\n%1\n可在 chrome://tracing 或 Perfetto 中打开。").arg(filePath));
+    } else {
+        QMessageBox::critical(this, "导出失败", "无法写入追踪文件！");
+    }
+}
+
+void MainWindow::reconcileStock(bool repair)
+{
+    if (m_reconcileWatcher && m_reconcileWatcher->isRunning()) {
+        return;
+    }
+    if (!m_reconcileWatcher) {
+        m_reconcileWatcher = new QFutureWatcher<StockReconciler::Report>(this);
+        connect(m_reconcileWatcher, &QFutureWatcher<StockReconciler::Report>::finished,
+                this, &MainWindow::onReconcileFinished);
+    }
+
+    // 后台线程只用自建连接，分片信息先在GUI线程取出
+    const DatabaseManager& dbManager = DatabaseManager::getInstance();
+    const QVector<ShardInfo> shards = dbManager.shards();
+    const int busyTimeoutMs = dbManager.busyTimeout();
+    m_reconcileRepair = repair;
+    m_reconcileAction->setEnabled(false);
+    this->statusBar()->showMessage(repair ? "正在修复库存..." : "正在核对库存...");
+    m_reconcileWatcher->setFuture(QtConcurrent::run([shards, repair, busyTimeoutMs]() {
+        return StockReconciler::run(shards, repair, busyTimeoutMs);
+    }));
+}
+
+void MainWindow::onReconcileFinished()
+{
+    m_reconcileAction->setEnabled(true);
+    this->statusBar()->clearMessage();
+    const StockReconciler::Report report = m_reconcileWatcher->result();
+    if (!report.ok) {
+        QMessageBox::critical(this, "库存核对", "库存核对失败，请查看日志！");
+        return;
+    }
+
+    const DatabaseManager& dbManager = DatabaseManager::getInstance();
+    QString summary = QString("共核对图书 %1 种，耗时 %2 ms，发现库存不一致 %3 种。")
+                          .arg(report.booksChecked).arg(report.elapsedMs).arg(report.discrepancies.size());
+    if (m_reconcileRepair) {
+        summary += QString("\n已修复 %1 种；核对后又有变动而跳过 %2 种；借出多于馆藏需人工核实 %3 种。")
+                       .arg(report.repaired).arg(report.conflicts).arg(report.unrepairable);
+        m_bookPanel->refreshBookList();
+    }
+
+    QMessageBox box(QMessageBox::Information, "库存核对", summary, QMessageBox::Ok, this);
+    if (!report.discrepancies.isEmpty()) {
+        // 明细过多时只列前若干条
+        const int shown = qMin(report.discrepancies.size(), MAX_DISCREPANCY_DETAILS);
+        QStringList lines;
+        for (int i = 0; i < shown; ++i) {
+            const StockReconciler::Discrepancy& item = report.discrepancies[i];
+            lines << QString("[%1] %2 %3：库存 %4，馆藏 %5，未还及留书 %6，应为 %7")
+                         .arg(dbManager.branchName(item.shard), item.bookId, item.bookName)
+                         .arg(item.stock).arg(item.totalCopies).arg(item.activeLoans).arg(item.expectedStock());
+        }
+        if (shown < report.discrepancies.size()) {
+            lines << QString("……其余 %1 条未列出").arg(report.discrepancies.size() - shown);
+        }
+        box.setDetailedText(lines.join('\n'));
+        if (!m_reconcileRepair) {
+            box.setText(summary + "\n是否按馆藏总数与未还借阅数修复库存？");
+            box.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+        }
+    }
+    if (box.exec() == QMessageBox::Yes) {
+        reconcileStock(true);
+    }
+}
+
 void MainWindow::on_funcListWidget_currentRowChanged(int currentRow)
 {
     // 切换堆叠窗口的当前面板
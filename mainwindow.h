@@ -2,9 +2,11 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QFutureWatcher>
 #include "bookpanel.h"
 #include "readerpanel.h"
 #include "borrowpanel.h"
+#include "stock_reconciler.h"
 
 namespace Ui {
 class MainWindow;
@@ -22,6 +24,13 @@ private slots:
     // 左侧功能列表切换
     void on_funcListWidget_currentRowChanged(int currentRow);
 
+    // 导出性能追踪（Chrome trace JSON）
+    void exportTrace();
+
+    // 库存核对（后台执行，完成后汇报差异并可选择修复）
+    void reconcileStock(bool repair = false);
+    void onReconcileFinished();
+
 private:
     Ui::MainWindow *ui;
 
@@ -30,8 +39,15 @@ private:
     ReaderPanel* m_readerPanel;
     BorrowPanel* m_borrowPanel;
 
+    QAction* m_reconcileAction = nullptr;
+    QFutureWatcher<StockReconciler::Report>* m_reconcileWatcher = nullptr;
+    bool m_reconcileRepair = false;
+
     // 初始化菜单栏
     void initMenuBar();
+
+    const int CHECKPOINT_INTERVAL_MS = 60 * 1000; // WAL检查点周期
+    const int MAX_DISCREPANCY_DETAILS = 500;      // 核对报告最多列出的明细条数
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,77 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// 无锁多生产者单消费者队列（侵入式链表，Vyukov算法）
+// 入队只有一次原子交换，任意线程可并发调用；出队只能由同一个消费线程调用
+// 生产者交换头指针后、链接next之前被挂起时，消费者暂时看不到该元素及其后的元素（下次出队再取）
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : m_head(&m_stub), m_tail(&m_stub) {}
+
+    ~MpscQueue() {
+        T value;
+        while (pop(&value)) {
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value) {
+        link(new Node(std::move(value)));
+    }
+
+    // 取出队首元素（仅消费线程），队列为空或队首尚未链接完成时返回false
+    bool pop(T* value) {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &m_stub) {
+            if (!next) {
+                return false;
+            }
+            m_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (!next) {
+            // 队中只剩最后一个元素：先把哑节点挂到队尾，才能安全取走它
+            if (tail != m_head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            link(&m_stub);
+            next = tail->next.load(std::memory_order_acquire);
+            if (!next) {
+                return false;
+            }
+        }
+        m_tail = next;
+        *value = std::move(tail->value);
+        delete tail;
+        return true;
+    }
+
+private:
+    struct Node {
+        Node() = default;
+        explicit Node(T v) : value(std::move(v)) {}
+
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+    void link(Node* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    Node m_stub;
+    std::atomic<Node*> m_head; // 生产者端
+    Node* m_tail;              // 消费者端
+};
+
+#endif // MPSC_QUEUE_H
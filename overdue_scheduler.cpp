@@ -0,0 +1,55 @@
+#include "overdue_scheduler.h"
+#include "database_manager.h"
+#include "trace.h"
+#include <QDateTime>
+
+OverdueScheduler::OverdueScheduler()
+{
+    // 时间轮粒度为1秒，每次触发只处理当前槽
+    m_timer.setInterval(1000);
+    m_timer.setTimerType(Qt::CoarseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &OverdueScheduler::onTick);
+}
+
+bool OverdueScheduler::start() {
+    TRACE_SCOPE("db", "OverdueScheduler::start");
+    m_wheel.reset(QDateTime::currentSecsSinceEpoch());
+    m_overdueIds.clear();
+
+    bool ok = false;
+    const QVector<DatabaseManager::LoanDue> loans = DatabaseManager::getInstance().getActiveLoanDueTimes(&ok);
+    if (!ok) {
+        qCritical() << "加载未归还借阅失败，逾期调度器未启动";
+        return false;
+    }
+    for (const DatabaseManager::LoanDue& loan : loans) {
+        m_wheel.schedule(loan.borrowId, loan.dueSecs);
+    }
+
+    // 已过期的借阅立即触发
+    onTick();
+    m_timer.start();
+    return true;
+}
+
+void OverdueScheduler::stop() {
+    m_timer.stop();
+}
+
+void OverdueScheduler::schedule(int borrowId, qint64 dueSecs) {
+    m_overdueIds.remove(borrowId);
+    m_wheel.schedule(borrowId, dueSecs);
+}
+
+void OverdueScheduler::cancel(int borrowId) {
+    m_wheel.cancel(borrowId);
+    m_overdueIds.remove(borrowId);
+}
+
+void OverdueScheduler::onTick() {
+    // 按墙钟推进（休眠唤醒后会一次性补齐经过的tick）
+    m_wheel.advanceTo(QDateTime::currentSecsSinceEpoch(), [this](int borrowId) {
+        m_overdueIds.insert(borrowId);
+        emit loanOverdue(borrowId);
+    });
+}
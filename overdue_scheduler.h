@@ -0,0 +1,54 @@
+#ifndef OVERDUE_SCHEDULER_H
+#define OVERDUE_SCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QSet>
+#include <QList>
+#include "timer_wheel.h"
+
+// 逾期调度器单例：用分层时间轮登记未归还借阅的应还时间，到期即发出逾期事件（不轮询数据库）
+class OverdueScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    static OverdueScheduler& getInstance() {
+        static OverdueScheduler instance;
+        return instance;
+    }
+
+    OverdueScheduler(const OverdueScheduler&) = delete;
+    OverdueScheduler& operator=(const OverdueScheduler&) = delete;
+
+    // 从数据库加载所有未归还借阅并启动时间轮（程序启动时执行）
+    bool start();
+
+    // 停止时间轮（程序退出前调用）
+    void stop();
+
+    // 登记/取消单条借阅的应还时间（秒级Unix时间戳）
+    void schedule(int borrowId, qint64 dueSecs);
+    void cancel(int borrowId);
+
+    // 本进程已触发逾期事件的借阅（其他终端的借阅不在其中；导出和审计按应还时间判断）
+    bool isOverdue(int borrowId) const { return m_overdueIds.contains(borrowId); }
+    QList<int> overdueIds() const { return m_overdueIds.values(); }
+    int overdueCount() const { return m_overdueIds.size(); }
+
+signals:
+    // 借阅到期未还时触发
+    void loanOverdue(int borrowId);
+
+private slots:
+    void onTick();
+
+private:
+    OverdueScheduler();
+    ~OverdueScheduler() override = default;
+
+    TimerWheel m_wheel;
+    QSet<int> m_overdueIds;
+    QTimer m_timer;
+};
+
+#endif // OVERDUE_SCHEDULER_H
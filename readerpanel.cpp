@@ -1,18 +1,30 @@
 #include "readerpanel.h"
 #include "ui_readerpanel.h"
+#include "trace.h"
+#include "schema.h"
 #include <QMessageBox>
+#include <QProgressDialog>
 
 ReaderPanel::ReaderPanel(QWidget *parent) :
     QWidget(parent),
-    ui(new Ui::ReaderPanel)
+    ui(new Ui::ReaderPanel),
+    m_changeTracker(ReaderTable::NAME, DatabaseManager::getInstance().currentShard())
 {
     ui->setupUi(this);
 
     // 初始化模型
     m_readerModel = DatabaseManager::getInstance().getReaderModel(this);
+    m_readerAudit = new AuditModelWatcher(m_readerModel, ReaderTable::ReaderId, -1, ReaderTable::ReaderId);
+    m_readerAudit->setDeleteNote("关联借阅记录已级联删除");
     ui->readerTableView->setModel(m_readerModel);
     ui->readerTableView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     ui->readerTableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ui->readerTableView->setSelectionMode(QAbstractItemView::ExtendedSelection); // 可多选批量删除
+
+    // 定时轮询其他终端的提交，只刷新变动的行
+    m_pollTimer = new QTimer(this);
+    connect(m_pollTimer, &QTimer::timeout, this, &ReaderPanel::onPollChanges);
+    m_pollTimer->start(CHANGE_POLL_INTERVAL_MS);
 }
 
 ReaderPanel::~ReaderPanel()
@@ -22,11 +34,23 @@ ReaderPanel::~ReaderPanel()
 
 void ReaderPanel::refreshReaderList()
 {
-    m_readerModel->select();
+    TRACE_SCOPE("ui", "ReaderPanel::refreshReaderList");
+    m_changeTracker.sync();
+    DatabaseManager::selectModel(m_readerModel);
+}
+
+void ReaderPanel::onPollChanges()
+{
+    // 面板不可见时不刷新，切回时一次补齐
+    if (!isVisible()) {
+        return;
+    }
+    m_changeTracker.refreshModel(m_readerModel, ReaderTable::ReaderId);
 }
 
 void ReaderPanel::on_addReaderBtn_clicked()
 {
+    TRACE_SCOPE("ui", "ReaderPanel::on_addReaderBtn_clicked");
     const QString readerId = ui->readerIdEdit->text().trimmed();
     const QString readerName = ui->readerNameEdit->text().trimmed();
     const QString phone = ui->readerPhoneEdit->text().trimmed();
@@ -37,11 +61,8 @@ void ReaderPanel::on_addReaderBtn_clicked()
         return;
     }
 
-    // 检查编号是否重复
-    QSqlQuery query(DatabaseManager::getInstance().getDatabase());
-    query.prepare("SELECT 1 FROM reader WHERE reader_id = ?");
-    query.addBindValue(readerId);
-    if (query.exec() && query.next()) {
+    // 检查编号是否重复（编号在所有分馆间唯一）
+    if (DatabaseManager::getInstance().findReaderShard(readerId) >= 0) {
         QMessageBox::warning(this, "错误", "读者编号已存在！");
         return;
     }
@@ -49,12 +70,12 @@ void ReaderPanel::on_addReaderBtn_clicked()
     // 插入新行
     const int row = m_readerModel->rowCount();
     m_readerModel->insertRow(row);
-    m_readerModel->setData(m_readerModel->index(row, 0), readerId);
-    m_readerModel->setData(m_readerModel->index(row, 1), readerName);
-    m_readerModel->setData(m_readerModel->index(row, 2), phone);
+    m_readerModel->setData(m_readerModel->index(row, ReaderTable::ReaderId), readerId);
+    m_readerModel->setData(m_readerModel->index(row, ReaderTable::ReaderName), readerName);
+    m_readerModel->setData(m_readerModel->index(row, ReaderTable::Phone), phone);
 
     // 提交
-    if (m_readerModel->submitAll()) {
+    if (m_readerAudit->submitAll()) {
         QMessageBox::information(this, "成功", "新增读者成功！");
         refreshReaderList();
         // 清空输入
@@ -69,29 +90,52 @@ void ReaderPanel::on_addReaderBtn_clicked()
 
 void ReaderPanel::on_delReaderBtn_clicked()
 {
-    const QModelIndex currentIndex = ui->readerTableView->currentIndex();
-    if (!currentIndex.isValid()) {
+    TRACE_SCOPE("ui", "ReaderPanel::on_delReaderBtn_clicked");
+    const QModelIndexList selectedRows = ui->readerTableView->selectionModel()->selectedRows(ReaderTable::ReaderId);
+    if (selectedRows.isEmpty()) {
         QMessageBox::warning(this, "操作错误", "请选择要删除的读者！");
         return;
     }
+    QStringList readerIds;
+    for (const QModelIndex& index : selectedRows) {
+        readerIds << index.data().toString();
+    }
 
-    if (QMessageBox::question(this, "确认删除", "确定要删除选中的读者吗？\n关联的借阅记录也会被删除！",
+    if (QMessageBox::question(this, "确认删除",
+                              QString("确定要删除选中的 %1 位读者吗？\n关联的借阅记录与预约也会被删除！")
+                                  .arg(readerIds.size()),
                               QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes) {
         return;
     }
 
-    m_readerModel->removeRow(currentIndex.row());
-    if (m_readerModel->submitAll()) {
-        QMessageBox::information(this, "成功", "删除读者成功！");
-        refreshReaderList();
+    // 分块删除并显示进度；期间暂停轮询，结束后整表刷新一次
+    m_pollTimer->stop();
+    QProgressDialog progressDialog("正在删除读者……", "停止", 0, readerIds.size(), this);
+    progressDialog.setWindowModality(Qt::WindowModal);
+    progressDialog.setMinimumDuration(PROGRESS_DELAY_MS);
+    const DatabaseManager::BulkDeleteResult result = DatabaseManager::getInstance().deleteReaders(
+        readerIds, [&progressDialog](int done, int) {
+            progressDialog.setValue(done);
+            return !progressDialog.wasCanceled();
+        });
+    progressDialog.reset();
+    m_pollTimer->start(CHANGE_POLL_INTERVAL_MS);
+    refreshReaderList();
+
+    QString summary = QString("已删除 %1 位读者").arg(result.deleted);
+    if (result.skipped > 0) {
+        summary += QString("，%1 位有未还借阅或留书，未删除").arg(result.skipped);
+    }
+    if (result.ok) {
+        QMessageBox::information(this, "删除完成", summary + "。");
     } else {
-        QMessageBox::critical(this, "失败", "删除读者失败：" + m_readerModel->lastError().text());
-        m_readerModel->revertAll();
+        QMessageBox::critical(this, "失败", "删除读者未全部完成：" + summary + "。");
     }
 }
 
 void ReaderPanel::on_searchReaderBtn_clicked()
 {
+    TRACE_SCOPE("ui", "ReaderPanel::on_searchReaderBtn_clicked");
     const QString keyword = ui->readerSearchEdit->text().trimmed();
     if (keyword.isEmpty()) {
         QMessageBox::warning(this, "提示", "请输入搜索关键词！");
@@ -102,15 +146,16 @@ void ReaderPanel::on_searchReaderBtn_clicked()
                                "reader_id LIKE '%%1%' OR reader_name LIKE '%%1%' OR phone LIKE '%%1%'"
                                ).arg(keyword);
     m_readerModel->setFilter(filter);
-    m_readerModel->select();
+    DatabaseManager::selectModel(m_readerModel);
 
-    const int count = m_readerModel->rowCount();
+    const int count = DatabaseManager::countRows(m_readerModel);
     QMessageBox::information(this, "搜索结果", QString("共找到 %1 条匹配记录").arg(count));
 }
 
 void ReaderPanel::on_resetSearchBtn_clicked()
 {
+    TRACE_SCOPE("ui", "ReaderPanel::on_resetSearchBtn_clicked");
     m_readerModel->setFilter("");
-    m_readerModel->select();
+    DatabaseManager::selectModel(m_readerModel);
     ui->readerSearchEdit->clear();
 }
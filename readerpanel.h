@@ -3,7 +3,10 @@
 
 #include <QWidget>
 #include <QSqlTableModel>
+#include <QTimer>
 #include "database_manager.h"
+#include "audit_log.h"
+#include "change_tracker.h"
 
 namespace Ui {
 class ReaderPanel;
@@ -22,13 +25,21 @@ public:
 
 private slots:
     void on_addReaderBtn_clicked();    // 新增读者
-    void on_delReaderBtn_clicked();    // 删除读者
+    void on_delReaderBtn_clicked();    // 删除选中读者（可多选）
     void on_searchReaderBtn_clicked(); // 搜索读者
     void on_resetSearchBtn_clicked(); // 重置搜索
 
+    void onPollChanges();            // 轮询其他终端的数据变更
+
 private:
     Ui::ReaderPanel *ui;
     QSqlTableModel* m_readerModel;
+    AuditModelWatcher* m_readerAudit; // 提交时记录审计事件
+    ChangeTracker m_changeTracker; // 增量刷新游标
+    QTimer* m_pollTimer;
+
+    const int CHANGE_POLL_INTERVAL_MS = 2000; // 变更轮询周期
+    const int PROGRESS_DELAY_MS = 500;        // 批量删除超过此时长才弹出进度框
 };
 
 #endif // READERPANEL_H
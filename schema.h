@@ -0,0 +1,395 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <QAbstractItemModel>
+#include <QDebug>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QString>
+#include <QStringList>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+
+// 编译期表结构描述：建表语句、界面表头、导出表头都由同一份描述生成，避免多处手写同一结构
+
+// 表列描述
+struct ColumnDef {
+    const char* name;   // 列名
+    const char* decl;   // 类型与约束（建表/补列时使用）
+    const char* label;  // 友好列名（界面表头）
+};
+
+// 查询/导出列描述（label为nullptr表示仅供程序使用，不导出）
+struct SelectColumnDef {
+    const char* expr;      // 查询表达式
+    const char* label;     // 导出表头
+    bool numeric = false;  // 整数列（JSON Lines输出为数字，列式格式按整数存储）
+};
+
+// 图书表
+struct BookTable {
+    static constexpr const char* NAME = "book";
+    enum Column { BookId, BookName, Author, Category, Stock, TotalCopies, ColumnCount };
+    static constexpr ColumnDef COLUMNS[ColumnCount] = {
+        {"book_id", "VARCHAR(20) PRIMARY KEY NOT NULL", "图书编号"},
+        {"book_name", "VARCHAR(100) NOT NULL", "图书名称"},
+        {"author", "VARCHAR(50) NOT NULL", "作者"},
+        {"category", "VARCHAR(30)", "分类"},
+        {"stock", "INTEGER NOT NULL DEFAULT 0 CHECK(stock >= 0)", "库存"},
+        {"total_copies", "INTEGER NOT NULL DEFAULT 0 CHECK(total_copies >= 0)", "馆藏总数"}, // 库存 = 馆藏总数 - 未还借阅数
+    };
+    static constexpr const char* CONSTRAINTS = "";
+};
+
+// 读者表
+struct ReaderTable {
+    static constexpr const char* NAME = "reader";
+    enum Column { ReaderId, ReaderName, Phone, Priority, ColumnCount };
+    static constexpr ColumnDef COLUMNS[ColumnCount] = {
+        {"reader_id", "VARCHAR(20) PRIMARY KEY NOT NULL", "读者编号"},
+        {"reader_name", "VARCHAR(50) NOT NULL", "读者姓名"},
+        {"phone", "VARCHAR(20)", "联系方式"},
+        {"priority", "INTEGER NOT NULL DEFAULT 0", "预约优先级"}, // 由馆员指定，数值大者在预约队列中优先
+    };
+    static constexpr const char* CONSTRAINTS = "";
+};
+
+// 借阅表：存于图书所在分片；读者可登记在任一分馆，reader_id可能引用其他分片的读者表，
+// 因此只对图书声明外键（读者是否存在由借书事务跨分片校验）
+// 旧版本建的表仍带读者外键声明：连接未开启foreign_keys，不会生效
+struct BorrowTable {
+    static constexpr const char* NAME = "borrow";
+    enum Column { Id, BookId, ReaderId, BorrowTime, ReturnTime, DueTime, ColumnCount };
+    static constexpr ColumnDef COLUMNS[ColumnCount] = {
+        {"id", "INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL", "借阅ID"},
+        {"book_id", "VARCHAR(20) NOT NULL", "图书编号"},
+        {"reader_id", "VARCHAR(20) NOT NULL", "读者编号"},
+        {"borrow_time", "DATETIME DEFAULT CURRENT_TIMESTAMP", "借书时间"},
+        {"return_time", "DATETIME", "还书时间"},
+        {"due_time", "DATETIME", "应还时间"},
+    };
+    static constexpr const char* CONSTRAINTS = "FOREIGN KEY(book_id) REFERENCES book(book_id) ON DELETE CASCADE";
+};
+
+// 预约表：库存不足时登记，还书时在同一事务内把副本留给队首读者（状态W→H），读者取书后为F
+// 留书期限内未取则过期（X），读者或馆员可取消（C）；已留出的副本不计入库存
+// 与借阅表相同，reader_id可能引用其他分片的读者，只对图书声明外键
+struct ReservationTable {
+    static constexpr const char* NAME = "reservation";
+    enum Column { Id, BookId, ReaderId, Priority, ReserveTime, Status, HoldUntil, ColumnCount };
+    static constexpr ColumnDef COLUMNS[ColumnCount] = {
+        {"id", "INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL", "预约ID"},
+        {"book_id", "VARCHAR(20) NOT NULL", "图书编号"},
+        {"reader_id", "VARCHAR(20) NOT NULL", "读者编号"},
+        {"priority", "INTEGER NOT NULL DEFAULT 0", "优先级"}, // 登记时读者的预约优先级
+        {"reserve_time", "DATETIME DEFAULT CURRENT_TIMESTAMP", "预约时间"},
+        {"status", "CHAR(1) NOT NULL DEFAULT 'W'", "状态"}, // W等待/H已留书/F已取书/X已过期/C已取消
+        {"hold_until", "DATETIME", "留书截止"},
+    };
+    static constexpr const char* CONSTRAINTS = "FOREIGN KEY(book_id) REFERENCES book(book_id) ON DELETE CASCADE";
+};
+
+// 变更日志表：由各业务表的触发器写入，供其他终端按游标增量同步
+struct ChangeLogTable {
+    static constexpr const char* NAME = "change_log";
+    enum Column { Seq, Tbl, RowKey, Op, ChangeTime, ColumnCount };
+    static constexpr ColumnDef COLUMNS[ColumnCount] = {
+        {"seq", "INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL", "序号"},
+        {"tbl", "VARCHAR(30) NOT NULL", "表名"},
+        {"row_key", "VARCHAR(20) NOT NULL", "主键"},
+        {"op", "CHAR(1) NOT NULL", "操作"}, // I/U/D
+        {"change_time", "DATETIME DEFAULT CURRENT_TIMESTAMP", "变更时间"},
+    };
+    static constexpr const char* CONSTRAINTS = "";
+};
+
+// 流通日汇总表：每天每本书的借出/归还次数，由借阅表触发器在借还事务内累加，趋势报表只合并这些桶
+// （删除图书/读者时级联删除的借阅记录不回减：汇总反映的是已发生的流通）
+struct CirculationDailyTable {
+    static constexpr const char* NAME = "circulation_daily";
+    enum Column { Day, BookId, Category, Borrows, Returns, ColumnCount };
+    static constexpr ColumnDef COLUMNS[ColumnCount] = {
+        {"day", "DATE NOT NULL", "日期"}, // 本地日期 yyyy-MM-dd
+        {"book_id", "VARCHAR(20) NOT NULL", "图书编号"},
+        {"category", "VARCHAR(30) NOT NULL DEFAULT ''", "分类"}, // 首次计入当天时的图书分类
+        {"borrows", "INTEGER NOT NULL DEFAULT 0", "借出次数"},
+        {"returns", "INTEGER NOT NULL DEFAULT 0", "归还次数"},
+    };
+    static constexpr const char* CONSTRAINTS = "PRIMARY KEY(day, book_id)";
+};
+
+// 按列名取列序号（编译期）
+template <typename Table>
+constexpr int columnIndex(std::string_view name) {
+    for (int i = 0; i < Table::ColumnCount; ++i) {
+        if (name == Table::COLUMNS[i].name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 列序号枚举须与描述数组一致
+static_assert(columnIndex<BookTable>("stock") == BookTable::Stock, "book列描述与枚举不一致");
+static_assert(columnIndex<ReaderTable>("phone") == ReaderTable::Phone, "reader列描述与枚举不一致");
+static_assert(columnIndex<BorrowTable>("due_time") == BorrowTable::DueTime, "borrow列描述与枚举不一致");
+static_assert(columnIndex<ReservationTable>("hold_until") == ReservationTable::HoldUntil,
+              "reservation列描述与枚举不一致");
+
+// 生成建表语句
+template <typename Table>
+QString createTableSql() {
+    QStringList parts;
+    for (const ColumnDef& column : Table::COLUMNS) {
+        parts << QString("%1 %2").arg(column.name, column.decl);
+    }
+    if (*Table::CONSTRAINTS) {
+        parts << Table::CONSTRAINTS;
+    }
+    return QString("CREATE TABLE IF NOT EXISTS %1 (\n    %2\n)").arg(Table::NAME, parts.join(",\n    "));
+}
+
+// 旧库升级：按描述补齐表中缺少的列，补上的列以"表名.列名"追加到added（供调用方回填数据）
+template <typename Table>
+bool addMissingColumns(QSqlDatabase& db, QStringList* added) {
+    QSqlQuery query(db);
+    if (!query.exec(QString("PRAGMA table_info(%1)").arg(Table::NAME))) {
+        qCritical() << "读取表结构失败：" << Table::NAME << query.lastError().text();
+        return false;
+    }
+    QStringList existing;
+    while (query.next()) {
+        existing << query.value(1).toString(); // 第2列为列名
+    }
+
+    for (const ColumnDef& column : Table::COLUMNS) {
+        if (existing.contains(QLatin1String(column.name), Qt::CaseInsensitive)) {
+            continue;
+        }
+        if (!query.exec(QString("ALTER TABLE %1 ADD COLUMN %2 %3").arg(Table::NAME, column.name, column.decl))) {
+            qCritical() << "补齐列失败：" << Table::NAME << column.name << query.lastError().text();
+            return false;
+        }
+        added->append(QString("%1.%2").arg(Table::NAME, column.name));
+    }
+    return true;
+}
+
+// 生成变更日志触发器（主键为首列；更新改动主键时旧键记为删除）
+template <typename Table>
+QStringList changeTriggerSql() {
+    const QString table = Table::NAME;
+    const QString key = Table::COLUMNS[0].name;
+    const QString insertLog = QString("INSERT INTO %1 (tbl, row_key, op) ").arg(ChangeLogTable::NAME);
+    return {
+        QString("CREATE TRIGGER IF NOT EXISTS trg_%1_log_insert AFTER INSERT ON %1 BEGIN "
+                "%3VALUES ('%1', NEW.%2, 'I'); END").arg(table, key, insertLog),
+        QString("CREATE TRIGGER IF NOT EXISTS trg_%1_log_update AFTER UPDATE ON %1 BEGIN "
+                "%3VALUES ('%1', NEW.%2, 'U'); "
+                "%3SELECT '%1', OLD.%2, 'D' WHERE OLD.%2 IS NOT NEW.%2; END").arg(table, key, insertLog),
+        QString("CREATE TRIGGER IF NOT EXISTS trg_%1_log_delete AFTER DELETE ON %1 BEGIN "
+                "%3VALUES ('%1', OLD.%2, 'D'); END").arg(table, key, insertLog),
+    };
+}
+
+// 借还时间所属的汇总日（本地日期；触发器与历史回填须用同一表达式）
+inline QString rollupDaySql(const QString& timeExpr) {
+    return QString("date(%1, 'localtime')").arg(timeExpr);
+}
+
+// 生成流通汇总触发器：借出计入借书日，归还计入还书日（插入时已带还书时间的历史记录两者都计）
+inline QStringList rollupTriggerSql() {
+    const QString table = CirculationDailyTable::NAME;
+    auto bump = [&table](const QString& timeColumn, const QString& counter) {
+        return QString("INSERT INTO %1 (day, book_id, category, %3) "
+                       "SELECT %2, NEW.book_id, COALESCE((SELECT category FROM book WHERE book_id = NEW.book_id), ''), 1 "
+                       "WHERE NEW.%4 IS NOT NULL "
+                       "ON CONFLICT(day, book_id) DO UPDATE SET %3 = %3 + 1;")
+            .arg(table, rollupDaySql("NEW." + timeColumn), counter, timeColumn);
+    };
+    return {
+        QString("CREATE TRIGGER IF NOT EXISTS trg_borrow_rollup_insert AFTER INSERT ON borrow BEGIN %1 %2 END")
+            .arg(bump("borrow_time", "borrows"), bump("return_time", "returns")),
+        QString("CREATE TRIGGER IF NOT EXISTS trg_borrow_rollup_return AFTER UPDATE OF return_time ON borrow "
+                "WHEN OLD.return_time IS NULL BEGIN %1 END").arg(bump("return_time", "returns")),
+    };
+}
+
+// 界面表头
+template <typename Table>
+QStringList headerLabels() {
+    QStringList labels;
+    for (const ColumnDef& column : Table::COLUMNS) {
+        labels << QString::fromUtf8(column.label);
+    }
+    return labels;
+}
+
+template <typename Table>
+void applyHeaderLabels(QAbstractItemModel* model) {
+    for (int i = 0; i < Table::ColumnCount; ++i) {
+        model->setHeaderData(i, Qt::Horizontal, QString::fromUtf8(Table::COLUMNS[i].label));
+    }
+}
+
+// 生成查询列清单
+template <typename View>
+QString selectListSql() {
+    QStringList exprs;
+    for (const SelectColumnDef& column : View::COLUMNS) {
+        exprs << column.expr;
+    }
+    return exprs.join(", ");
+}
+
+// 生成表的全部列名清单（按描述顺序）
+template <typename Table>
+QString columnListSql() {
+    QStringList names;
+    for (const ColumnDef& column : Table::COLUMNS) {
+        names << column.name;
+    }
+    return names.join(", ");
+}
+
+// 预约队列视图（借阅面板显示）：已留书的排在前，等待中的按优先级、登记先后排列
+struct ReservationQueueView {
+    enum Column { Id, BookId, BookName, ReaderId, Priority, Status, ReserveTime, HoldUntil, ColumnCount };
+    static constexpr SelectColumnDef COLUMNS[ColumnCount] = {
+        {"r.id", "预约ID", true},
+        {"r.book_id", "图书编号"},
+        {"b.book_name", "图书名称"},
+        {"r.reader_id", "读者编号"},
+        {"r.priority", "优先级", true},
+        {"CASE r.status WHEN 'H' THEN '已留书' ELSE '等待中' END", "状态"},
+        {"r.reserve_time", "预约时间"},
+        {"r.hold_until", "留书截止"},
+    };
+    static constexpr const char* ORDER_BY = "r.book_id, r.status = 'W', r.priority DESC, r.id";
+};
+
+// 等待中的预约（启动时加载到内存队列）
+struct ReservationWaitRecord {
+    std::int64_t id;
+    std::string_view bookId;
+    std::string_view readerId;
+    std::int64_t priority;
+
+    static constexpr auto FIELDS = std::make_tuple(
+        &ReservationWaitRecord::id, &ReservationWaitRecord::bookId, &ReservationWaitRecord::readerId,
+        &ReservationWaitRecord::priority);
+};
+
+// 借阅导出视图：查询列与BorrowExportRecord字段一一对应
+struct BorrowExportView {
+    static constexpr int ColumnCount = 8;
+    static constexpr SelectColumnDef COLUMNS[ColumnCount] = {
+        {"b.id", "借阅ID", true},
+        {"b.book_id", "图书编号"},
+        {"b.reader_id", "读者编号"},
+        {"r.reader_name", "读者姓名"},
+        {"b.borrow_time", "借书时间"},
+        {"b.return_time IS NULL", "还书状态"},
+        {"CAST(strftime('%s', b.borrow_time) AS INTEGER)", nullptr}, // 归并排序键
+        {"b.return_time IS NULL AND b.due_time <= datetime('now')", nullptr}, // 已逾期（按应还时间，与本进程的逾期事件无关）
+    };
+};
+
+// 借阅导出行（文本字段为视图，仅在当前行有效）
+struct BorrowExportRecord {
+    std::int64_t id;
+    std::string_view bookId;
+    std::string_view readerId;
+    std::string_view readerName;
+    std::string_view borrowTime;
+    bool unreturned;
+    std::int64_t borrowEpoch;
+    bool overdue;
+
+    static constexpr auto FIELDS = std::make_tuple(
+        &BorrowExportRecord::id, &BorrowExportRecord::bookId, &BorrowExportRecord::readerId,
+        &BorrowExportRecord::readerName, &BorrowExportRecord::borrowTime,
+        &BorrowExportRecord::unreturned, &BorrowExportRecord::borrowEpoch, &BorrowExportRecord::overdue);
+};
+static_assert(std::tuple_size<decltype(BorrowExportRecord::FIELDS)>::value == BorrowExportView::ColumnCount,
+              "导出行字段与导出视图列数不一致");
+
+// 未归还借阅的应还时间
+struct LoanDueRecord {
+    std::int64_t borrowId;
+    std::int64_t dueSecs;
+
+    static constexpr auto FIELDS = std::make_tuple(&LoanDueRecord::borrowId, &LoanDueRecord::dueSecs);
+};
+
+// 目录快照行：按表结构描述的列序读取
+struct BookCatalogRecord {
+    std::string_view bookId;
+    std::string_view bookName;
+    std::string_view author;
+    std::string_view category;
+    std::int64_t stock;
+    std::int64_t totalCopies;
+
+    static constexpr auto FIELDS = std::make_tuple(
+        &BookCatalogRecord::bookId, &BookCatalogRecord::bookName, &BookCatalogRecord::author,
+        &BookCatalogRecord::category, &BookCatalogRecord::stock, &BookCatalogRecord::totalCopies);
+};
+static_assert(std::tuple_size<decltype(BookCatalogRecord::FIELDS)>::value == BookTable::ColumnCount,
+              "图书快照行字段与图书表列数不一致");
+
+struct ReaderCatalogRecord {
+    std::string_view readerId;
+    std::string_view readerName;
+    std::string_view phone;
+    std::int64_t priority;
+
+    static constexpr auto FIELDS = std::make_tuple(
+        &ReaderCatalogRecord::readerId, &ReaderCatalogRecord::readerName, &ReaderCatalogRecord::phone,
+        &ReaderCatalogRecord::priority);
+};
+static_assert(std::tuple_size<decltype(ReaderCatalogRecord::FIELDS)>::value == ReaderTable::ColumnCount,
+              "读者快照行字段与读者表列数不一致");
+
+// 流通汇总回填行：某区间借阅记录按(日期, 图书)分组的次数
+struct CirculationCountRecord {
+    std::string_view day;
+    std::string_view bookId;
+    std::string_view category;
+    std::int64_t count;
+
+    static constexpr auto FIELDS = std::make_tuple(
+        &CirculationCountRecord::day, &CirculationCountRecord::bookId, &CirculationCountRecord::category,
+        &CirculationCountRecord::count);
+};
+
+// 流通汇总桶（附图书名称，供报表取前N名）
+struct CirculationBucketRecord {
+    std::string_view day;
+    std::string_view bookId;
+    std::string_view category;
+    std::int64_t borrows;
+    std::int64_t returns;
+    std::string_view bookName;
+
+    static constexpr auto FIELDS = std::make_tuple(
+        &CirculationBucketRecord::day, &CirculationBucketRecord::bookId, &CirculationBucketRecord::category,
+        &CirculationBucketRecord::borrows, &CirculationBucketRecord::returns, &CirculationBucketRecord::bookName);
+};
+
+// 库存核对行：图书库存、馆藏总数与在外副本数（未还借阅加已为预约读者留出的副本）
+struct StockCheckRecord {
+    std::string_view bookId;
+    std::string_view bookName;
+    std::int64_t stock;
+    std::int64_t totalCopies;
+    std::int64_t activeLoans;
+
+    static constexpr auto FIELDS = std::make_tuple(
+        &StockCheckRecord::bookId, &StockCheckRecord::bookName, &StockCheckRecord::stock,
+        &StockCheckRecord::totalCopies, &StockCheckRecord::activeLoans);
+};
+
+#endif // SCHEMA_H
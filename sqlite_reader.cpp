@@ -0,0 +1,106 @@
+#include "sqlite_reader.h"
+#include "database_manager.h"
+#include <QSqlError>
+#include <QSqlRecord>
+
+SqliteConnection::SqliteConnection() = default;
+
+SqliteConnection::~SqliteConnection() {
+    close();
+}
+
+bool SqliteConnection::open(const QString& filePath, bool readOnly) {
+    close();
+    m_conn = std::make_unique<ScopedConnection>(filePath, readOnly);
+    if (!m_conn->isOpen()) {
+        m_lastError = m_conn->database().lastError().text();
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SqliteConnection::close() {
+    m_conn.reset(); // 析构时结束读快照并移除连接
+}
+
+bool SqliteConnection::isOpen() const {
+    return m_conn && m_conn->isOpen();
+}
+
+QString SqliteConnection::errorMessage() const {
+    if (!m_lastError.isEmpty()) {
+        return m_lastError;
+    }
+    return m_conn ? m_conn->database().lastError().text() : QString("database not open");
+}
+
+bool SqliteConnection::beginSnapshot() {
+    return isOpen() && m_conn->beginSnapshot();
+}
+
+SqliteStatement::SqliteStatement(SqliteConnection& conn, const char* sql)
+    : m_conn(conn) {
+    if (!conn.isOpen()) {
+        m_failed = true;
+        return;
+    }
+    m_query = QSqlQuery(conn.m_conn->database());
+    m_query.setForwardOnly(true);
+    m_prepared = m_query.prepare(QString::fromUtf8(sql));
+    if (!m_prepared) {
+        fail();
+    }
+}
+
+bool SqliteStatement::bind(int index, std::int64_t value) {
+    if (m_failed) {
+        return false;
+    }
+    m_query.bindValue(index - 1, QVariant(qlonglong(value)));
+    return true;
+}
+
+bool SqliteStatement::bind(int index, std::string_view value) {
+    if (m_failed) {
+        return false;
+    }
+    m_query.bindValue(index - 1, QString::fromUtf8(value.data(), int(value.size())));
+    return true;
+}
+
+bool SqliteStatement::step() {
+    if (m_failed) {
+        return false;
+    }
+    if (!m_executed) {
+        if (!m_query.exec()) {
+            fail();
+            return false;
+        }
+        m_executed = true;
+        m_columnCount = m_query.record().count();
+        m_text.assign(std::size_t(m_columnCount), QByteArray());
+    }
+    if (m_query.next()) {
+        return true;
+    }
+    if (m_query.lastError().isValid()) {
+        fail();
+    }
+    return false;
+}
+
+void SqliteStatement::reset() {
+    if (!m_prepared) {
+        return;
+    }
+    m_query.finish(); // 保留已绑定的参数，下次step重新执行
+    m_executed = false;
+    m_failed = false;
+}
+
+void SqliteStatement::fail() {
+    m_failed = true;
+    m_conn.m_lastError = m_query.lastError().text();
+}
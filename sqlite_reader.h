@@ -0,0 +1,130 @@
+#ifndef SQLITE_READER_H
+#define SQLITE_READER_H
+
+#include <QByteArray>
+#include <QSqlQuery>
+#include <QString>
+#include <QVariant>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+class ScopedConnection;
+
+// 批量只读访问：走Qt的QSQLITE驱动（与界面连接同一份SQLite库，不另行链接libsqlite3），
+// 按列序号取值并解码为C++基本类型，供导出、快照、汇总等逐行扫描的后台任务使用
+class SqliteConnection {
+public:
+    SqliteConnection();
+    ~SqliteConnection();
+
+    SqliteConnection(const SqliteConnection&) = delete;
+    SqliteConnection& operator=(const SqliteConnection&) = delete;
+
+    // 在当前线程打开独立连接（只读时附加query_only，防止误写；连接级参数按存储配置档设置）
+    bool open(const QString& filePath, bool readOnly = true);
+    void close();
+
+    bool isOpen() const;
+    QString errorMessage() const;
+
+    // 开启读快照（事务内所有查询读到同一提交版本，close时结束）
+    bool beginSnapshot();
+
+private:
+    friend class SqliteStatement;
+
+    std::unique_ptr<ScopedConnection> m_conn;
+    QString m_lastError; // 最近一次语句错误（QSqlQuery的错误不记在连接上）
+};
+
+// 列解码：文本列返回指向语句内部缓冲的UTF-8视图，有效期至下一次step/reset；NULL返回空视图（data()为nullptr）
+template <typename T>
+struct ColumnDecoder;
+
+template <>
+struct ColumnDecoder<std::int64_t> {
+    static std::int64_t decode(const QVariant& value, QByteArray&) { return value.toLongLong(); }
+};
+
+template <>
+struct ColumnDecoder<int> {
+    static int decode(const QVariant& value, QByteArray&) { return value.toInt(); }
+};
+
+template <>
+struct ColumnDecoder<double> {
+    static double decode(const QVariant& value, QByteArray&) { return value.toDouble(); }
+};
+
+template <>
+struct ColumnDecoder<bool> {
+    static bool decode(const QVariant& value, QByteArray&) { return value.toLongLong() != 0; }
+};
+
+template <>
+struct ColumnDecoder<std::string_view> {
+    static std::string_view decode(const QVariant& value, QByteArray& buffer) {
+        if (value.isNull()) {
+            return std::string_view();
+        }
+        buffer = value.toString().toUtf8();
+        return std::string_view(buffer.constData(), std::size_t(buffer.size()));
+    }
+};
+
+// 预编译语句（只进游标，首次step时执行）
+class SqliteStatement {
+public:
+    SqliteStatement(SqliteConnection& conn, const char* sql);
+
+    SqliteStatement(const SqliteStatement&) = delete;
+    SqliteStatement& operator=(const SqliteStatement&) = delete;
+
+    bool isValid() const { return !m_failed; }
+
+    // 参数绑定（序号从1开始）
+    bool bind(int index, std::int64_t value);
+    bool bind(int index, std::string_view value);
+
+    // 取下一行：有数据返回true；结束或出错返回false（用failed()区分）
+    bool step();
+    bool failed() const { return m_failed; }
+    void reset();
+
+    int columnCount() const { return m_columnCount; }
+
+    template <typename T>
+    T column(int col) const { return ColumnDecoder<T>::decode(m_query.value(col), m_text[std::size_t(col)]); }
+
+    // 按Row::FIELDS（成员指针元组）顺序把当前行逐列解码到row，列按序号读取，不按列名查找
+    template <typename Row>
+    void decode(Row& row) const {
+        std::apply([&](auto... members) {
+            int col = 0;
+            ((row.*members = column<std::remove_reference_t<decltype(row.*members)>>(col++)), ...);
+        }, Row::FIELDS);
+    }
+
+private:
+    void fail();
+
+    SqliteConnection& m_conn;
+    QSqlQuery m_query;
+    bool m_prepared = false;
+    bool m_executed = false;
+    bool m_failed = false;
+    int m_columnCount = 0;
+    mutable std::vector<QByteArray> m_text; // 各文本列的UTF-8缓冲（视图指向这里）
+};
+
+// 编译期字段数（用于校验查询列数与行结构一致）
+template <typename Row>
+constexpr int fieldCount() {
+    return int(std::tuple_size<decltype(Row::FIELDS)>::value);
+}
+
+#endif // SQLITE_READER_H
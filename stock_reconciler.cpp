@@ -0,0 +1,240 @@
+#include "stock_reconciler.h"
+#include "audit_log.h"
+#include "schema.h"
+#include "sqlite_reader.h"
+#include "trace.h"
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrent>
+
+StockReconciler::Report StockReconciler::run(const QVector<ShardInfo>& shards, bool repair, int busyTimeoutMs) {
+    TRACE_SCOPE("reconcile", "StockReconciler::run");
+    QElapsedTimer timer;
+    timer.start();
+    Report report;
+
+    // 先划分所有分片的区间，再统一并行核对
+    const int maxPartitions = qMax(1, QThread::idealThreadCount());
+    QVector<QFuture<RangeResult>> futures;
+    for (const ShardInfo& shard : shards) {
+        QVector<BookRange> ranges;
+        if (!planRanges(shard, maxPartitions, &ranges)) {
+            qCritical() << "划分核对区间失败：" << shard.branch;
+            return report;
+        }
+        for (const BookRange& range : ranges) {
+            futures.append(QtConcurrent::run([range]() { return checkRange(range); }));
+        }
+    }
+
+    bool allOk = true;
+    for (QFuture<RangeResult>& future : futures) {
+        const RangeResult result = future.result();
+        allOk = allOk && result.ok;
+        report.booksChecked += result.checked;
+        report.discrepancies += result.discrepancies;
+    }
+    if (!allOk) {
+        qCritical() << "核对库存失败";
+        return report;
+    }
+
+    if (repair) {
+        for (const ShardInfo& shard : shards) {
+            QVector<Discrepancy> shardDiscrepancies;
+            for (const Discrepancy& discrepancy : report.discrepancies) {
+                if (discrepancy.shard == shard.index) {
+                    shardDiscrepancies.append(discrepancy);
+                }
+            }
+            if (!shardDiscrepancies.isEmpty()) {
+                repairShard(shard, shardDiscrepancies, busyTimeoutMs, &report);
+            }
+        }
+    }
+
+    report.ok = true;
+    report.elapsedMs = timer.elapsed();
+    return report;
+}
+
+bool StockReconciler::planRanges(const ShardInfo& shard, int maxPartitions, QVector<BookRange>* ranges) {
+    TRACE_SCOPE("reconcile", "StockReconciler::planRanges");
+    ranges->clear();
+
+    SqliteConnection conn;
+    if (!conn.open(shard.filePath) || !conn.beginSnapshot()) {
+        qCritical() << "打开只读连接失败：" << shard.branch << conn.errorMessage();
+        return false;
+    }
+
+    std::int64_t bookCount = 0;
+    {
+        SqliteStatement stmt(conn, "SELECT count(*) FROM book");
+        if (!stmt.step()) {
+            qCritical() << "统计图书失败：" << conn.errorMessage();
+            return false;
+        }
+        bookCount = stmt.column<std::int64_t>(0);
+    }
+
+    BookRange range;
+    range.shard = shard;
+    const int partitions = int(qBound<std::int64_t>(1, bookCount / MIN_BOOKS_PER_PARTITION, maxPartitions));
+    if (partitions > 1) {
+        // 仅扫描主键索引，每隔 bookCount/partitions 本取一个边界编号
+        SqliteStatement stmt(conn, "SELECT book_id FROM book ORDER BY book_id");
+        const std::int64_t step = bookCount / partitions;
+        std::int64_t index = 0;
+        while (stmt.step() && ranges->size() < partitions - 1) {
+            if (index++ != step * (ranges->size() + 1)) {
+                continue;
+            }
+            // 边界编号是下一区间的第一本：本区间上界（不含）、下一区间下界（含）
+            const std::string_view bookId = stmt.column<std::string_view>(0);
+            range.hasUpper = true;
+            range.upperId = QByteArray(bookId.data(), int(bookId.size()));
+            ranges->append(range);
+
+            range.hasLower = true;
+            range.lowerId = range.upperId;
+            range.hasUpper = false;
+            range.upperId.clear();
+        }
+        if (stmt.failed()) {
+            qCritical() << "扫描图书编号失败：" << conn.errorMessage();
+            return false;
+        }
+    }
+    ranges->append(range);
+    return true;
+}
+
+StockReconciler::RangeResult StockReconciler::checkRange(const BookRange& range) {
+    TRACE_SCOPE("reconcile", "StockReconciler::checkRange");
+    RangeResult result;
+
+    // 读快照内核对：同一区间内库存与借阅数取自同一提交版本
+    SqliteConnection conn;
+    if (!conn.open(range.shard.filePath) || !conn.beginSnapshot()) {
+        qCritical() << "打开只读连接失败：" << range.shard.branch << conn.errorMessage();
+        return result;
+    }
+
+    QByteArray sql = "SELECT b.book_id, b.book_name, b.stock, b.total_copies, "
+                     "(SELECT COUNT(*) FROM borrow br WHERE br.book_id = b.book_id AND br.return_time IS NULL) "
+                     "+ (SELECT COUNT(*) FROM reservation rv WHERE rv.book_id = b.book_id AND rv.status = 'H') "
+                     "FROM book b WHERE 1";
+    if (range.hasLower) {
+        sql += " AND b.book_id >= ?";
+    }
+    if (range.hasUpper) {
+        sql += " AND b.book_id < ?";
+    }
+    SqliteStatement stmt(conn, sql.constData());
+    int param = 1;
+    if (range.hasLower) {
+        stmt.bind(param++, std::string_view(range.lowerId.constData(), std::size_t(range.lowerId.size())));
+    }
+    if (range.hasUpper) {
+        stmt.bind(param++, std::string_view(range.upperId.constData(), std::size_t(range.upperId.size())));
+    }
+
+    StockCheckRecord record;
+    while (stmt.step()) {
+        stmt.decode(record);
+        ++result.checked;
+        if (record.stock == record.totalCopies - record.activeLoans) {
+            continue;
+        }
+        result.discrepancies.append({range.shard.index,
+                                     QString::fromUtf8(record.bookId.data(), int(record.bookId.size())),
+                                     QString::fromUtf8(record.bookName.data(), int(record.bookName.size())),
+                                     int(record.stock), int(record.totalCopies), int(record.activeLoans)});
+    }
+    if (stmt.failed()) {
+        qCritical() << "核对库存失败：" << range.shard.branch << conn.errorMessage();
+        return result;
+    }
+    result.ok = true;
+    return result;
+}
+
+void StockReconciler::repairShard(const ShardInfo& shard, const QVector<Discrepancy>& discrepancies,
+                                  int busyTimeoutMs, Report* report) {
+    TRACE_SCOPE("reconcile", "StockReconciler::repairShard");
+    ScopedConnection conn(shard.filePath);
+    if (!conn.isOpen()) {
+        report->conflicts += discrepancies.size();
+        return;
+    }
+    QSqlDatabase& db = conn.database();
+    QSqlQuery query(db);
+    query.exec(QString("PRAGMA busy_timeout = %1").arg(busyTimeoutMs));
+
+    for (int begin = 0; begin < discrepancies.size(); begin += REPAIR_BATCH_SIZE) {
+        const int end = qMin(begin + REPAIR_BATCH_SIZE, discrepancies.size());
+
+        // 立即获取写锁，避免读升级写时与借还事务互等
+        if (!query.exec("BEGIN IMMEDIATE")) {
+            qWarning() << "库存修复事务开启失败：" << query.lastError().text();
+            report->conflicts += end - begin;
+            continue;
+        }
+        query.prepare("UPDATE book SET stock = ? WHERE book_id = ? AND stock = ? AND total_copies = ? "
+                      "AND (SELECT COUNT(*) FROM borrow WHERE borrow.book_id = book.book_id "
+                      "AND borrow.return_time IS NULL) "
+                      "+ (SELECT COUNT(*) FROM reservation WHERE reservation.book_id = book.book_id "
+                      "AND reservation.status = 'H') = ?");
+        QVector<int> repairedRows;
+        int conflicts = 0;
+        int unrepairable = 0;
+        bool success = true;
+        for (int i = begin; success && i < end; ++i) {
+            const Discrepancy& discrepancy = discrepancies[i];
+            // 借出多于馆藏：无法确定应改库存还是馆藏，留给人工处理
+            if (discrepancy.expectedStock() < 0) {
+                ++unrepairable;
+                continue;
+            }
+            query.addBindValue(discrepancy.expectedStock());
+            query.addBindValue(discrepancy.bookId);
+            query.addBindValue(discrepancy.stock);
+            query.addBindValue(discrepancy.totalCopies);
+            query.addBindValue(discrepancy.activeLoans);
+            success = query.exec();
+            if (success && query.numRowsAffected() == 1) {
+                repairedRows.append(i);
+            } else if (success) {
+                ++conflicts;
+            }
+        }
+
+        if (!success || !db.commit()) {
+            qWarning() << "库存修复失败：" << shard.branch << query.lastError().text() << db.lastError().text();
+            db.rollback();
+            report->conflicts += end - begin - unrepairable;
+            report->unrepairable += unrepairable;
+            continue;
+        }
+        report->repaired += repairedRows.size();
+        report->conflicts += conflicts;
+        report->unrepairable += unrepairable;
+
+        // 已提交的修复记入审计日志
+        for (int i : repairedRows) {
+            const Discrepancy& discrepancy = discrepancies[i];
+            AuditEvent event;
+            event.action = AuditEvent::Update;
+            event.table = BookTable::NAME;
+            event.branch = shard.branch;
+            event.rowKey = discrepancy.bookId;
+            event.bookId = discrepancy.bookId;
+            event.detail = QString("stock: %1 -> %2（库存核对修复，馆藏%3、借出及留书%4）")
+                               .arg(discrepancy.stock).arg(discrepancy.expectedStock())
+                               .arg(discrepancy.totalCopies).arg(discrepancy.activeLoans);
+            AuditLog::getInstance().record(std::move(event));
+        }
+    }
+}
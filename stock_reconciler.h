@@ -0,0 +1,70 @@
+#ifndef STOCK_RECONCILER_H
+#define STOCK_RECONCILER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include "database_manager.h"
+
+// 静态工具类：库存一致性核对（库存应等于馆藏总数减在外副本数：未还借阅加已为预约读者留出的副本）
+// 各分片按图书编号切分区间并行统计，只读快照连接不阻塞借还；修复在短小的批量事务中进行
+class StockReconciler {
+public:
+    struct Discrepancy {
+        int shard;
+        QString bookId;
+        QString bookName;
+        int stock;
+        int totalCopies;
+        int activeLoans; // 在外副本数（含留书）
+
+        int expectedStock() const { return totalCopies - activeLoans; }
+    };
+
+    struct Report {
+        bool ok = false;
+        qint64 booksChecked = 0;
+        QVector<Discrepancy> discrepancies;
+        int repaired = 0;     // 已修复
+        int conflicts = 0;    // 核对后又有借还或编辑，跳过（重新核对即可）
+        int unrepairable = 0; // 未还借阅数超过馆藏总数，需人工核实馆藏
+        qint64 elapsedMs = 0;
+    };
+
+    // 核对所有分片（只使用自建连接，可在后台线程调用）；repair为true时同时修复差异
+    static Report run(const QVector<ShardInfo>& shards, bool repair, int busyTimeoutMs);
+
+private:
+    // 私有构造：禁止实例化
+    StockReconciler() = default;
+    ~StockReconciler() = default;
+
+    // 核对区间：图书编号 [lowerId, upperId)
+    struct BookRange {
+        ShardInfo shard;
+        bool hasLower = false;
+        QByteArray lowerId;
+        bool hasUpper = false;
+        QByteArray upperId;
+    };
+
+    struct RangeResult {
+        QVector<Discrepancy> discrepancies;
+        qint64 checked = 0;
+        bool ok = false;
+    };
+
+    // 沿主键索引扫描一遍，按图书数等分出区间边界
+    static bool planRanges(const ShardInfo& shard, int maxPartitions, QVector<BookRange>* ranges);
+
+    static RangeResult checkRange(const BookRange& range);
+
+    // 按批修复：更新条件带上核对时读到的库存、馆藏与借阅数，期间有变动的图书不覆盖
+    static void repairShard(const ShardInfo& shard, const QVector<Discrepancy>& discrepancies,
+                            int busyTimeoutMs, Report* report);
+
+    static constexpr int MIN_BOOKS_PER_PARTITION = 5000; // 区间过小时并行收益不抵开销
+    static constexpr int REPAIR_BATCH_SIZE = 200;        // 每个修复事务的图书数（写锁持有时间短）
+};
+
+#endif // STOCK_RECONCILER_H
@@ -0,0 +1,82 @@
+#include "storage_profile.h"
+#include <QDebug>
+#include <QSqlError>
+#include <QSqlQuery>
+
+const StorageProfile StorageProfile::PROFILES[] = {
+    // 默认：每次提交刷盘，借还记录不因断电丢失；缓存与内存映射放宽，读多的面板与检索受益
+    {"durable", "每次提交刷盘，断电不丢已提交的借还", "WAL", "FULL", 16 * 1024, 64LL * 1024 * 1024, "MEMORY", 4096},
+    // 只在检查点刷盘：提交不再等fsync，断电最多回退到最近一次检查点
+    {"balanced", "检查点时刷盘，提交延迟低", "WAL", "NORMAL", 32 * 1024, 256LL * 1024 * 1024, "MEMORY", 4096},
+    // 批量导入、迁移等可重做的场景：不刷盘，大缓存、大页
+    {"bulk-load", "不刷盘，供批量导入等可重做的作业", "WAL", "OFF", 128 * 1024, 1024LL * 1024 * 1024, "MEMORY", 8192},
+};
+
+const int StorageProfile::PROFILE_COUNT = int(sizeof(PROFILES) / sizeof(PROFILES[0]));
+
+const StorageProfile* StorageProfile::find(const QString& name) {
+    for (const StorageProfile& profile : PROFILES) {
+        if (name == QLatin1String(profile.name)) {
+            return &profile;
+        }
+    }
+    return nullptr;
+}
+
+QStringList StorageProfile::names() {
+    QStringList result;
+    for (const StorageProfile& profile : PROFILES) {
+        result << profile.name;
+    }
+    return result;
+}
+
+bool StorageProfile::applyWriter(QSqlDatabase& db) const {
+    QSqlQuery query(db);
+
+    // 页大小须在建第一张表、进入WAL之前设置，已有内容的库上为空操作
+    query.exec(QString("PRAGMA page_size = %1").arg(pageSize));
+
+    if (!query.exec(QString("PRAGMA journal_mode = %1").arg(journalMode)) || !query.next()
+        || query.value(0).toString().compare(journalMode, Qt::CaseInsensitive) != 0) {
+        qCritical() << "设置日志模式失败：" << journalMode << query.lastError().text();
+        return false;
+    }
+    applyConnection(db, true);
+    return true;
+}
+
+void StorageProfile::applyConnection(QSqlDatabase& db, bool writer) const {
+    QSqlQuery query(db);
+    QStringList pragmas = connectionPragmas();
+    if (writer) {
+        pragmas << QString("PRAGMA synchronous = %1").arg(synchronous);
+    }
+    for (const QString& pragma : pragmas) {
+        if (!query.exec(pragma)) {
+            qWarning() << "设置连接参数失败：" << pragma << query.lastError().text();
+        }
+    }
+}
+
+QStringList StorageProfile::connectionPragmas() const {
+    return {
+        QString("PRAGMA cache_size = -%1").arg(cacheSizeKiB),
+        QString("PRAGMA mmap_size = %1").arg(mmapSize),
+        QString("PRAGMA temp_store = %1").arg(tempStore),
+    };
+}
+
+bool StorageProfile::rebuild(QSqlDatabase& db) const {
+    // WAL模式下不能改页大小：先退出WAL，VACUUM按新页大小重写整个文件，再由applyWriter恢复
+    QSqlQuery query(db);
+    const QString steps[] = {"PRAGMA journal_mode = DELETE", QString("PRAGMA page_size = %1").arg(pageSize),
+                             "VACUUM"};
+    for (const QString& step : steps) {
+        if (!query.exec(step)) {
+            qCritical() << "重建数据库失败：" << step << query.lastError().text();
+            return false;
+        }
+    }
+    return applyWriter(db);
+}
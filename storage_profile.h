@@ -0,0 +1,43 @@
+#ifndef STORAGE_PROFILE_H
+#define STORAGE_PROFILE_H
+
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+
+// 存储配置档：连接打开时设置的SQLite参数（durable / balanced / bulk-load）
+// 三档的日志模式都是WAL：只读快照连接、多终端并发借还和检查点调度都依赖WAL，各档的差别在同步级别与缓存
+struct StorageProfile {
+    const char* name;         // 配置档名称（命令行使用）
+    const char* description;  // 说明
+    const char* journalMode;  // journal_mode
+    const char* synchronous;  // synchronous：FULL每次提交都刷盘；NORMAL只在检查点刷盘，断电可能丢最近的提交但不会损坏；OFF不刷盘
+    int cacheSizeKiB;         // cache_size（每个连接，KiB）
+    qint64 mmapSize;          // mmap_size（字节，0为不映射）
+    const char* tempStore;    // temp_store：排序、临时索引放内存还是临时文件
+    int pageSize;             // page_size（只对新建的库生效，已有的库须rebuild）
+
+    // 所有配置档（第一个为默认）
+    static const StorageProfile PROFILES[];
+    static const int PROFILE_COUNT;
+
+    static const StorageProfile& defaultProfile() { return PROFILES[0]; }
+
+    // 按名称查找，未找到返回nullptr
+    static const StorageProfile* find(const QString& name);
+    static QStringList names();
+
+    // 写连接：页大小（空库时）、日志模式、同步级别及连接级参数
+    bool applyWriter(QSqlDatabase& db) const;
+
+    // 连接级参数：缓存、内存映射、临时存储（writer为true时附加同步级别）
+    void applyConnection(QSqlDatabase& db, bool writer) const;
+
+    // 连接级参数的PRAGMA语句
+    QStringList connectionPragmas() const;
+
+    // 按本档页大小重建已有的库（退出WAL后VACUUM；须独占文件，基准测试在副本上使用）
+    bool rebuild(QSqlDatabase& db) const;
+};
+
+#endif // STORAGE_PROFILE_H
@@ -0,0 +1,109 @@
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel(std::int64_t startTick)
+    : m_currentTick(startTick)
+{
+}
+
+void TimerWheel::reset(std::int64_t tick) {
+    for (auto& level : m_slots) {
+        for (auto& slot : level) {
+            slot.clear();
+        }
+    }
+    m_overflow.clear();
+    m_due.clear();
+    m_pending.clear();
+    m_currentTick = tick;
+}
+
+void TimerWheel::schedule(int id, std::int64_t dueTick) {
+    m_pending[id] = dueTick;
+    place(Entry{id, dueTick});
+}
+
+void TimerWheel::cancel(int id) {
+    m_pending.erase(id);
+}
+
+void TimerWheel::place(const Entry& entry) {
+    const std::int64_t delta = entry.dueTick - m_currentTick;
+    if (delta <= 0) {
+        m_due.push_back(entry);
+        return;
+    }
+
+    // 按剩余时间选择层级：第l层覆盖 [64^l, 64^(l+1)) 个tick，槽位由到期时间的绝对值决定
+    for (int level = 0; level < LEVEL_COUNT; ++level) {
+        if (delta < (std::int64_t(1) << (SLOT_BITS * (level + 1)))) {
+            const int slot = int((entry.dueTick >> (SLOT_BITS * level)) & SLOT_MASK);
+            m_slots[level][slot].push_back(entry);
+            return;
+        }
+    }
+    m_overflow.push_back(entry);
+}
+
+void TimerWheel::cascade(int level) {
+    // 将高层当前槽的项重新分配到低层（此时它们的剩余时间已不足本层跨度）
+    const int slot = int((m_currentTick >> (SLOT_BITS * level)) & SLOT_MASK);
+    std::vector<Entry> entries;
+    entries.swap(m_slots[level][slot]);
+    for (const Entry& entry : entries) {
+        place(entry);
+    }
+}
+
+void TimerWheel::fire(const Entry& entry, const ExpireCallback& onExpire) {
+    // 丢弃已取消或被重新登记的残留项
+    auto it = m_pending.find(entry.id);
+    if (it == m_pending.end() || it->second != entry.dueTick) {
+        return;
+    }
+    m_pending.erase(it);
+    onExpire(entry.id);
+}
+
+void TimerWheel::advanceTo(std::int64_t tick, const ExpireCallback& onExpire) {
+    if (!m_due.empty()) {
+        std::vector<Entry> due;
+        due.swap(m_due);
+        for (const Entry& entry : due) {
+            fire(entry, onExpire);
+        }
+    }
+
+    while (m_currentTick < tick) {
+        ++m_currentTick;
+
+        // 低层转完一圈时逐层向上级联
+        for (int level = 1; level < LEVEL_COUNT; ++level) {
+            if ((m_currentTick >> (SLOT_BITS * (level - 1))) & SLOT_MASK) {
+                break;
+            }
+            cascade(level);
+            if (level == LEVEL_COUNT - 1
+                && ((m_currentTick >> (SLOT_BITS * level)) & SLOT_MASK) == 0) {
+                std::vector<Entry> overflow;
+                overflow.swap(m_overflow);
+                for (const Entry& entry : overflow) {
+                    place(entry);
+                }
+            }
+        }
+
+        std::vector<Entry> entries;
+        entries.swap(m_slots[0][m_currentTick & SLOT_MASK]);
+        for (const Entry& entry : entries) {
+            fire(entry, onExpire);
+        }
+        // 级联过程中可能产生恰好在当前tick到期的项
+        if (!m_due.empty()) {
+            std::vector<Entry> due;
+            due.swap(m_due);
+            for (const Entry& entry : due) {
+                fire(entry, onExpire);
+            }
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// 分层时间轮：4层×64槽，1个tick=1秒，可覆盖约194天；更远的到期项放入溢出链表
+// 插入/取消 O(1)，每次推进只处理当前槽，不做全量扫描
+class TimerWheel {
+public:
+    using ExpireCallback = std::function<void(int id)>;
+
+    explicit TimerWheel(std::int64_t startTick = 0);
+
+    // 重置时间轮（清空所有定时项）
+    void reset(std::int64_t tick);
+
+    // 登记定时项（同一id重复登记时以最后一次为准；已到期的项在下次推进时立即触发）
+    void schedule(int id, std::int64_t dueTick);
+
+    // 取消定时项（惰性删除：仅从登记表移除，槽中残留项触发前会被丢弃）
+    void cancel(int id);
+
+    // 推进到指定tick，依次触发所有到期项
+    void advanceTo(std::int64_t tick, const ExpireCallback& onExpire);
+
+    std::int64_t currentTick() const { return m_currentTick; }
+    std::size_t pendingCount() const { return m_pending.size(); }
+
+private:
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOT_COUNT = 1 << SLOT_BITS;
+    static constexpr int SLOT_MASK = SLOT_COUNT - 1;
+    static constexpr int LEVEL_COUNT = 4;
+
+    struct Entry {
+        int id;
+        std::int64_t dueTick;
+    };
+
+    void place(const Entry& entry);
+    void cascade(int level);
+    void fire(const Entry& entry, const ExpireCallback& onExpire);
+
+    std::vector<Entry> m_slots[LEVEL_COUNT][SLOT_COUNT];
+    std::vector<Entry> m_overflow;  // 超出时间轮范围的远期项
+    std::vector<Entry> m_due;       // 登记时已到期、等待下次推进触发的项
+    std::unordered_map<int, std::int64_t> m_pending; // id -> 到期tick（有效登记）
+    std::int64_t m_currentTick;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,212 @@
+#include "trace.h"
+#include <QAbstractItemView>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QThread>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+std::atomic<bool> Tracer::s_enabled{false};
+
+namespace {
+
+const int RING_CAPACITY = 1 << 14; // 每线程保留最近16384个事件
+const std::size_t MAX_RETIRED_BUFFERS = 16; // 已退出线程的缓冲最多保留这么多个（每个约512KiB），更早的释放
+
+// 环形缓冲槽位：字段均为relaxed原子量，导出线程与写入线程并发时不构成数据竞争
+struct TraceSlot {
+    std::atomic<const char*> category{nullptr};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<std::int64_t> startUs{0};
+    std::atomic<std::int64_t> durationUs{0};
+};
+
+// 单写者（所属线程）多读者环形缓冲：写入只移动head，不加锁
+struct ThreadBuffer {
+    int tid = 0;
+    QString threadName;
+    std::atomic<std::uint64_t> head{0};
+    TraceSlot slots[RING_CAPACITY];
+};
+
+// 缓冲登记表：只在线程首次记录时加锁登记；线程退出后缓冲转入退役队列，导出时仍可见，
+// 退役的超过MAX_RETIRED_BUFFERS个时释放最早的（线程池线程空闲过期、每次导出新建线程池都会不断产生新线程）
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::deque<ThreadBuffer*> retired; // 按线程退出先后
+    int nextTid = 1;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// 每线程的缓冲持有者：线程退出时析构，把缓冲转入退役队列（正在导出的缓冲由导出端的引用保活）
+struct BufferHolder {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~BufferHolder() {
+        if (!buffer) {
+            return;
+        }
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.retired.push_back(buffer.get());
+        while (reg.retired.size() > MAX_RETIRED_BUFFERS) {
+            ThreadBuffer* oldest = reg.retired.front();
+            reg.retired.pop_front();
+            reg.buffers.erase(std::remove_if(reg.buffers.begin(), reg.buffers.end(),
+                                             [oldest](const std::shared_ptr<ThreadBuffer>& registered) {
+                                                 return registered.get() == oldest;
+                                             }),
+                              reg.buffers.end());
+        }
+    }
+};
+
+ThreadBuffer& currentBuffer() {
+    thread_local BufferHolder holder;
+    if (!holder.buffer) {
+        std::shared_ptr<ThreadBuffer> buffer = std::make_shared<ThreadBuffer>();
+        QThread* thread = QThread::currentThread();
+        const bool isMain = QCoreApplication::instance() && thread == QCoreApplication::instance()->thread();
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffer->tid = reg.nextTid++;
+        buffer->threadName = isMain ? QString("GUI")
+                                    : (thread && !thread->objectName().isEmpty()
+                                           ? thread->objectName()
+                                           : QString("worker-%1").arg(buffer->tid));
+        reg.buffers.push_back(buffer);
+        holder.buffer = std::move(buffer);
+    }
+    return *holder.buffer;
+}
+
+// JSON字符串转义（名称均为程序内常量，只需处理引号与反斜杠）
+void appendJsonString(QByteArray& out, const char* text) {
+    out += '"';
+    for (const char* p = text ? text : ""; *p; ++p) {
+        if (*p == '"' || *p == '\\') {
+            out += '\\';
+        }
+        out += *p;
+    }
+    out += '"';
+}
+
+} // namespace
+
+void Tracer::setEnabled(bool enabled) {
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Tracer::record(const char* category, const char* name, std::int64_t startUs, std::int64_t durationUs) {
+    ThreadBuffer& buffer = currentBuffer();
+    const std::uint64_t index = buffer.head.load(std::memory_order_relaxed);
+    TraceSlot& slot = buffer.slots[index % RING_CAPACITY];
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.startUs.store(startUs, std::memory_order_relaxed);
+    slot.durationUs.store(durationUs, std::memory_order_relaxed);
+    buffer.head.store(index + 1, std::memory_order_release);
+}
+
+int Tracer::eventCount() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    std::uint64_t count = 0;
+    for (const auto& buffer : reg.buffers) {
+        count += std::min<std::uint64_t>(buffer->head.load(std::memory_order_acquire), RING_CAPACITY);
+    }
+    return int(count);
+}
+
+bool Tracer::writeChromeTrace(const QString& filePath) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCritical() << "打开追踪文件失败：" << file.errorString();
+        return false;
+    }
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffers = reg.buffers;
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QByteArray out;
+    out.reserve(1 << 20);
+    out += "{\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& buffer : buffers) {
+        // 线程名元数据
+        out += first ? "" : ",\n";
+        first = false;
+        out += QString("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%1,\"tid\":%2,\"args\":{\"name\":")
+                   .arg(pid).arg(buffer->tid).toUtf8();
+        appendJsonString(out, buffer->threadName.toUtf8().constData());
+        out += "}}";
+
+        // 先读head，再拷贝槽位，最后再读一次head：拷贝期间可能被覆盖的最旧槽位丢弃
+        const std::uint64_t end = buffer->head.load(std::memory_order_acquire);
+        const std::uint64_t begin = end > RING_CAPACITY ? end - RING_CAPACITY : 0;
+        struct Copied {
+            std::uint64_t index;
+            const char* category;
+            const char* name;
+            std::int64_t startUs;
+            std::int64_t durationUs;
+        };
+        std::vector<Copied> copied;
+        copied.reserve(std::size_t(end - begin));
+        for (std::uint64_t i = begin; i < end; ++i) {
+            const TraceSlot& slot = buffer->slots[i % RING_CAPACITY];
+            copied.push_back({i, slot.category.load(std::memory_order_relaxed),
+                              slot.name.load(std::memory_order_relaxed),
+                              slot.startUs.load(std::memory_order_relaxed),
+                              slot.durationUs.load(std::memory_order_relaxed)});
+        }
+        // 获取栅栏：上面的槽位读取不得重排到再次读head之后，否则撕裂的槽位可能被当作完整事件
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const std::uint64_t headAfter = buffer->head.load(std::memory_order_acquire);
+        // 写入线程先填槽位headAfter % RING_CAPACITY再发布head，该槽位上的旧事件（序号headAfter - RING_CAPACITY）可能已被撕裂
+        const std::uint64_t safeBegin = headAfter >= RING_CAPACITY ? headAfter - RING_CAPACITY + 1 : 0;
+
+        for (const Copied& event : copied) {
+            if (event.index < safeBegin || !event.name) {
+                continue;
+            }
+            out += ",\n{\"ph\":\"X\",\"cat\":";
+            appendJsonString(out, event.category);
+            out += ",\"name\":";
+            appendJsonString(out, event.name);
+            out += QString(",\"ts\":%1,\"dur\":%2,\"pid\":%3,\"tid\":%4}")
+                       .arg(event.startUs).arg(event.durationUs).arg(pid).arg(buffer->tid).toUtf8();
+        }
+    }
+    out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    const bool ok = file.write(out) == out.size();
+    file.close();
+    return ok;
+}
+
+bool TracingApplication::notify(QObject* receiver, QEvent* event) {
+    // 仅在追踪开启时记录表格视图视口的重绘
+    std::optional<TraceScope> paintScope;
+    if (event->type() == QEvent::Paint && Tracer::isEnabled()
+        && qobject_cast<QAbstractItemView*>(receiver->parent())) {
+        paintScope.emplace("view", "QAbstractItemView::paint");
+    }
+    return QApplication::notify(receiver, event);
+}
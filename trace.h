@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QApplication>
+#include <QString>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// 轻量事件追踪：作用域耗时片段写入每线程无锁环形缓冲，按需导出为Chrome trace JSON（chrome://tracing / Perfetto）
+// 关闭时每个追踪点只有一次原子读和分支，名称须为字符串常量（只保存指针，不做复制）
+class Tracer {
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    // 当前时间（微秒，单调时钟）
+    static std::int64_t nowUs() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // 记录一个完整片段（写入当前线程的环形缓冲）
+    static void record(const char* category, const char* name, std::int64_t startUs, std::int64_t durationUs);
+
+    // 已记录事件数（各线程缓冲中仍保留的）
+    static int eventCount();
+
+    // 导出所有线程缓冲为Chrome trace JSON
+    static bool writeChromeTrace(const QString& filePath);
+
+private:
+    Tracer() = default;
+    ~Tracer() = default;
+
+    static std::atomic<bool> s_enabled;
+};
+
+// 作用域片段：构造时计时，析构时记录
+class TraceScope {
+public:
+    TraceScope(const char* category, const char* name)
+        : m_category(category), m_name(name), m_startUs(Tracer::isEnabled() ? Tracer::nowUs() : -1) {}
+
+    ~TraceScope() {
+        if (m_startUs >= 0) {
+            Tracer::record(m_category, m_name, m_startUs, Tracer::nowUs() - m_startUs);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_category;
+    const char* m_name;
+    std::int64_t m_startUs;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(category, name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(category, name)
+
+// 应用对象：追踪开启时记录表格视图的重绘耗时（区分SQL、模型刷新与界面重绘）
+class TracingApplication : public QApplication {
+public:
+    TracingApplication(int& argc, char** argv) : QApplication(argc, argv) {}
+
+    bool notify(QObject* receiver, QEvent* event) override;
+};
+
+#endif // TRACE_H
@@ -1,4 +1,4 @@
-QT       += core gui sql
+QT       += core gui sql concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,21 +9,64 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    audit_log.cpp \
+    benchmark.cpp \
     bookpanel.cpp \
     borrowpanel.cpp \
+    catalog_snapshot.cpp \
+    change_tracker.cpp \
+    circulation_report_dialog.cpp \
+    circulation_rollup.cpp \
     database_manager.cpp \
+    export_sink.cpp \
     file_exporter.cpp \
+    hold_queue.cpp \
     main.cpp \
     mainwindow.cpp \
-    readerpanel.cpp
+    overdue_scheduler.cpp \
+    readerpanel.cpp \
+    sqlite_reader.cpp \
+    stock_reconciler.cpp \
+    storage_profile.cpp \
+    timer_wheel.cpp \
+    trace.cpp
 
 HEADERS += \
+    audit_log.h \
+    benchmark.h \
     bookpanel.h \
     borrowpanel.h \
+    catalog_snapshot.h \
+    change_tracker.h \
+    circulation_report_dialog.h \
+    circulation_rollup.h \
     database_manager.h \
+    export_sink.h \
     file_exporter.h \
+    hold_queue.h \
     mainwindow.h \
-    readerpanel.h
+    mpsc_queue.h \
+    overdue_scheduler.h \
+    readerpanel.h \
+    schema.h \
+    sqlite_reader.h \
+    stock_reconciler.h \
+    storage_profile.h \
+    timer_wheel.h \
+    trace.h
+
+# 导出压缩与审计日志校验：zlib必需（gzip、CRC32），zstd可选（找到libzstd时启用）
+packagesExist(zlib) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += zlib
+} else {
+    LIBS += -lz
+}
+packagesExist(libzstd) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libzstd
+    DEFINES += ZHXM_HAVE_ZSTD
+}
 
 FORMS += \
     bookpanel.ui \